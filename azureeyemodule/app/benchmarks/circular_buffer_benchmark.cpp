@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ *
+ * Compares the put/get throughput of CircularBuffer and SPSCCircularBuffer with one producer thread
+ * and one consumer thread. Only built when configuring with -DBUILD_BENCHMARKS=ON.
+ *
+ * Usage: circular_buffer_benchmark [n_items] [capacity]
+ */
+
+// Standard library includes
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+// Local includes
+#include "../util/circular_buffer.hpp"
+#include "../util/spsc_circular_buffer.hpp"
+
+/** What a single run measured. */
+struct Result
+{
+    /** Wall time from the first put to the last put going in. */
+    double put_s;
+
+    /** Wall time from the first put to the last get. */
+    double elapsed_s;
+
+    /** How many items made it through to the consumer. */
+    size_t delivered;
+};
+
+/**
+ * CircularBuffer never refuses an item: when it is full, put() overwrites the oldest one. So the producer just
+ * puts as fast as it can and the consumer reads until it sees the last item, which nothing can overwrite.
+ */
+static Result run(circbuf::CircularBuffer<size_t> &buffer, size_t n_items)
+{
+    size_t delivered = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread consumer([&]{
+        size_t item = 0;
+        do
+        {
+            item = buffer.get();
+            delivered++;
+        } while (item != n_items - 1);
+    });
+
+    for (size_t i = 0; i < n_items; i++)
+    {
+        buffer.put(i);
+    }
+
+    std::chrono::duration<double> put_time = std::chrono::steady_clock::now() - start;
+
+    consumer.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return {put_time.count(), elapsed.count(), delivered};
+}
+
+/** SPSCCircularBuffer refuses an item when it is full, so the producer yields and tries again until it goes in. */
+static Result run(circbuf::SPSCCircularBuffer<size_t> &buffer, size_t n_items)
+{
+    size_t delivered = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread consumer([&]{
+        size_t item = 0;
+        do
+        {
+            item = buffer.get();
+            delivered++;
+        } while (item != n_items - 1);
+    });
+
+    for (size_t i = 0; i < n_items; i++)
+    {
+        while (!buffer.put(i))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    std::chrono::duration<double> put_time = std::chrono::steady_clock::now() - start;
+
+    consumer.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return {put_time.count(), elapsed.count(), delivered};
+}
+
+static void report(const std::string &name, const Result &result, size_t n_items)
+{
+    std::printf("%-20s %8.3f M puts/s  %8.3f M gets/s  %10zu delivered  %10zu dropped\n",
+                name.c_str(), (n_items / result.put_s) / 1e6, (result.delivered / result.elapsed_s) / 1e6,
+                result.delivered, n_items - result.delivered);
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t n_items = (argc > 1) ? std::stoul(argv[1]) : 10000000;
+    const size_t capacity = (argc > 2) ? std::stoul(argv[2]) : 16;
+    if ((n_items == 0) || (capacity == 0))
+    {
+        std::fprintf(stderr, "Usage: %s [n_items > 0] [capacity > 0]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%zu items through a buffer of capacity %zu, one producer and one consumer\n", n_items, capacity);
+
+    circbuf::CircularBuffer<size_t> locked(capacity);
+    report("CircularBuffer", run(locked, n_items), n_items);
+
+    circbuf::SPSCCircularBuffer<size_t> lock_free(capacity);
+    report("SPSCCircularBuffer", run(lock_free, n_items), n_items);
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ *
+ * Stress test for SPSCCircularBuffer's memory orderings. One producer pushes heap-allocated sequence numbers through
+ * a small buffer as fast as it can, while one consumer reads them back with a mix of get() and get_with_timeout()
+ * so that it keeps going to sleep and being woken up. Any lost wakeup hangs, any torn or reordered item
+ * fails the sequence check, and ThreadSanitizer (which this target is built with) reports any data race
+ * on the slots. Only built when configuring with -DBUILD_BENCHMARKS=ON.
+ *
+ * Usage: spsc_circular_buffer_stress [n_items]
+ */
+
+// Standard library includes
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Local includes
+#include "../util/spsc_circular_buffer.hpp"
+
+int main(int argc, char *argv[])
+{
+    const long n_items = (argc > 1) ? std::stol(argv[1]) : 2000000;
+    const size_t capacity = 8;
+
+    circbuf::SPSCCircularBuffer<std::unique_ptr<long>> buffer(capacity);
+    std::atomic<bool> failed{false};
+
+    std::thread consumer([&]{
+        for (long i = 0; i < n_items; i++)
+        {
+            std::unique_ptr<long> item;
+            if (i % 3 == 0)
+            {
+                item = buffer.get();
+            }
+            else
+            {
+                while (!buffer.get_with_timeout(item, 1))
+                {
+                }
+            }
+
+            if (!item || (*item != i))
+            {
+                std::fprintf(stderr, "Expected item %ld, got %ld\n", i, item ? *item : -1L);
+                failed = true;
+                return;
+            }
+
+            if (buffer.size_no_wait() > capacity)
+            {
+                std::fprintf(stderr, "size_no_wait() reported more than the capacity\n");
+                failed = true;
+                return;
+            }
+        }
+    });
+
+    for (long i = 0; i < n_items; i++)
+    {
+        std::unique_ptr<long> item(new long(i));
+        while (!buffer.put(std::move(item)))
+        {
+            if (failed)
+            {
+                break;
+            }
+            std::this_thread::yield();
+        }
+
+        if (failed)
+        {
+            break;
+        }
+    }
+
+    consumer.join();
+    if (failed)
+    {
+        return 1;
+    }
+
+    std::printf("%ld items passed through in order\n", n_items);
+    return 0;
+}
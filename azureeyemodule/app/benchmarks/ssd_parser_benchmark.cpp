@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ *
+ * Times ssd::parse_ssd against the scalar loop it replaced, over 1x1x100x7 and 1x1x200x7 SSD output tensors.
+ * Only built when configuring with -DBUILD_BENCHMARKS=ON.
+ *
+ * By default, the tensors are generated (with a fixed seed) to look like a DetectionOutput layer's: every row filled in,
+ * most of them with a low confidence. To use tensors recorded from a real network instead, pass the paths of files
+ * holding their raw float32 contents (N rows of 7 floats each).
+ *
+ * Usage: ssd_parser_benchmark [n_iterations] [recorded_tensor.raw ...]
+ */
+
+// Standard library includes
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+
+// Local includes
+#include "../kernels/ssd_parser.hpp"
+
+/** The network input size that boxes get scaled to. */
+static const cv::Size IMAGE_SIZE(1920, 1080);
+
+/** The parser's confidence threshold, as the SSD models use it. */
+static const float CONFIDENCE_THRESHOLD = 0.5f;
+
+/** Returns a synthetic {1, 1, n_proposals, 7} SSD output, sorted by descending confidence like a DetectionOutput layer's. */
+static std::vector<float> make_tensor(int n_proposals)
+{
+    std::mt19937 rng(n_proposals);
+    std::uniform_real_distribution<float> coordinate(0.0f, 0.8f);
+    std::uniform_real_distribution<float> extent(0.02f, 0.2f);
+    std::exponential_distribution<float> confidence(8.0f);
+    std::uniform_int_distribution<int> label(1, 90);
+
+    std::vector<float> confidences(n_proposals);
+    for (auto &c : confidences)
+    {
+        c = std::min(confidence(rng), 1.0f);
+    }
+    std::sort(confidences.begin(), confidences.end(), [](float a, float b){ return a > b; });
+
+    std::vector<float> tensor(static_cast<size_t>(n_proposals) * ssd::OBJECT_SIZE);
+    for (int i = 0; i < n_proposals; i++)
+    {
+        float *row = &tensor[static_cast<size_t>(i) * ssd::OBJECT_SIZE];
+        const float left = coordinate(rng);
+        const float top = coordinate(rng);
+        row[0] = 0.0f;
+        row[1] = static_cast<float>(label(rng));
+        row[2] = confidences[i];
+        row[3] = left;
+        row[4] = top;
+        row[5] = left + extent(rng);
+        row[6] = top + extent(rng);
+    }
+
+    return tensor;
+}
+
+/** Reads a recorded tensor of raw float32s. Returns an empty vector if the file can't be read or is not made of whole rows. */
+static std::vector<float> read_tensor(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return {};
+    }
+
+    const std::streamsize n_bytes = file.tellg();
+    if ((n_bytes <= 0) || (n_bytes % (ssd::OBJECT_SIZE * sizeof(float)) != 0))
+    {
+        return {};
+    }
+
+    std::vector<float> tensor(static_cast<size_t>(n_bytes) / sizeof(float));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(tensor.data()), n_bytes);
+    return file ? tensor : std::vector<float>{};
+}
+
+/** The scalar loop that GOCVParseSSDWithConf used before it moved to ssd::parse_ssd, kept here as the baseline. */
+static void parse_ssd_reference(const float *items, int n_proposals, const cv::Size &in_size, float confidence_threshold, int filter_label,
+                                std::vector<cv::Rect> &out_boxes, std::vector<int> &out_labels, std::vector<float> &out_confidences)
+{
+    out_boxes.clear();
+    out_labels.clear();
+    out_confidences.clear();
+
+    for (int i = 0; i < n_proposals; i++)
+    {
+        const auto it = items + i * ssd::OBJECT_SIZE;
+        if (it[0] < 0.f)
+        {
+            break;
+        }
+
+        if (it[2] < confidence_threshold)
+        {
+            continue;
+        }
+
+        if (filter_label != -1 && static_cast<int>(it[1]) != filter_label)
+        {
+            continue;
+        }
+
+        const cv::Rect surface({ 0, 0 }, in_size);
+
+        cv::Rect rc;
+        rc.x = static_cast<int>(it[3] * in_size.width);
+        rc.y = static_cast<int>(it[4] * in_size.height);
+        rc.width = static_cast<int>(it[5] * in_size.width) - rc.x;
+        rc.height = static_cast<int>(it[6] * in_size.height) - rc.y;
+        out_boxes.emplace_back(rc & surface);
+        out_labels.emplace_back(static_cast<int>(it[1]));
+        out_confidences.emplace_back(it[2]);
+    }
+}
+
+/** Returns the mean time in nanoseconds that `f` takes over the given number of iterations. */
+template <class F>
+static double time_ns(int n_iterations, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n_iterations; i++)
+    {
+        f();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / n_iterations;
+}
+
+static void run(const std::string &name, const std::vector<float> &tensor, int n_iterations)
+{
+    const int n_proposals = static_cast<int>(tensor.size() / ssd::OBJECT_SIZE);
+
+    // Outputs live across iterations, the same way the kernel's do across frames.
+    std::vector<cv::Rect> ref_boxes;
+    std::vector<int> ref_labels;
+    std::vector<float> ref_confidences;
+    const double reference = time_ns(n_iterations, [&]{
+        parse_ssd_reference(tensor.data(), n_proposals, IMAGE_SIZE, CONFIDENCE_THRESHOLD, -1, ref_boxes, ref_labels, ref_confidences);
+    });
+
+    std::vector<cv::Rect> boxes;
+    std::vector<int> labels;
+    std::vector<float> confidences;
+    ssd::DetectionBuffer out(boxes, labels, confidences);
+    const double parsed = time_ns(n_iterations, [&]{
+        ssd::parse_ssd(tensor.data(), n_proposals, IMAGE_SIZE, CONFIDENCE_THRESHOLD, -1, out);
+    });
+
+    const bool match = (ref_labels == labels) && (ref_confidences == confidences) && (ref_boxes.size() == boxes.size()) &&
+                       std::equal(ref_boxes.begin(), ref_boxes.end(), boxes.begin());
+    std::printf("%-24s %5d proposals  %5zu kept  reference %9.1f ns  parse_ssd %9.1f ns  (%.2fx)  %s\n",
+                name.c_str(), n_proposals, boxes.size(), reference, parsed, reference / parsed, match ? "outputs match" : "OUTPUTS DIFFER");
+}
+
+int main(int argc, char *argv[])
+{
+    const int n_iterations = (argc > 1) ? std::stoi(argv[1]) : 100000;
+    if (n_iterations <= 0)
+    {
+        std::fprintf(stderr, "Usage: %s [n_iterations > 0] [recorded_tensor.raw ...]\n", argv[0]);
+        return 1;
+    }
+
+    if (argc > 2)
+    {
+        for (int i = 2; i < argc; i++)
+        {
+            const auto tensor = read_tensor(argv[i]);
+            if (tensor.empty())
+            {
+                std::fprintf(stderr, "Could not read a tensor of 7-float rows from %s\n", argv[i]);
+                return 1;
+            }
+            run(argv[i], tensor, n_iterations);
+        }
+    }
+    else
+    {
+        run("synthetic 1x1x100x7", make_tensor(100), n_iterations);
+        run("synthetic 1x1x200x7", make_tensor(200), n_iterations);
+    }
+
+    return 0;
+}
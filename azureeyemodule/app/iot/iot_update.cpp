@@ -18,8 +18,10 @@
 
 // Local includes
 #include "iot_update.hpp"
+#include "../kernels/tuning.hpp"
 #include "../streaming/rtsp.hpp"
 #include "../util/helper.hpp"
+#include "../util/time_aligned_buffer.hpp"
 #include "../secure_ai/secureai.hpp"
 
 namespace iot {
@@ -396,6 +398,70 @@ static void parse_time_alignment(JSON_Object *root_object)
     }
 }
 
+/** Updates how we hold on to frames for time alignment from the given module twin string. */
+static void update_time_alignment_storage(const char *storage)
+{
+    if ((storage == nullptr) || !timebuf::is_valid_storage(storage))
+    {
+        util::log_error("Invalid TimeAlignStorage setting. It should be one of raw, resized, or jpeg.");
+        return;
+    }
+
+    util::log_info("Time Align Storage: " + std::string(storage));
+    timebuf::set_storage(timebuf::storage_string_to_enum(storage));
+}
+
+/** Parse out how we should hold on to frames for time alignment. Takes effect on the next frame, without restarting the pipeline. */
+static void parse_time_alignment_storage(JSON_Object *root_object)
+{
+    if (json_object_dotget_value(root_object, "desired.TimeAlignStorage") != nullptr)
+    {
+        update_time_alignment_storage(json_object_dotget_string(root_object, "desired.TimeAlignStorage"));
+    }
+    if (json_object_get_value(root_object, "TimeAlignStorage") != nullptr)
+    {
+        update_time_alignment_storage(json_object_get_string(root_object, "TimeAlignStorage"));
+    }
+}
+
+/** Updates (or, if the value is null, clears) the given live post-processing parameter from the given JSON value. */
+static void update_tuning_param(const tuning::Param &param, const JSON_Value *value)
+{
+    const std::string name = tuning::to_string(param);
+    if (json_value_get_type(value) == JSONNull)
+    {
+        util::log_info(name + " cleared. Using the model's default.");
+        tuning::clear(param);
+    }
+    else if ((json_value_get_type(value) == JSONNumber) && tuning::set(param, (float)json_value_get_number(value)))
+    {
+        util::log_info(name + ": " + std::to_string(json_value_get_number(value)));
+    }
+    else
+    {
+        util::log_error("Invalid " + name + " setting. It should be a number in " + tuning::valid_range(param) + ".");
+    }
+}
+
+/** Parse out the post-processing parameters (thresholds), which we can change without restarting the pipeline. */
+static void parse_tuning(JSON_Object *root_object)
+{
+    const tuning::Param params[] = { tuning::Param::CONFIDENCE_THRESHOLD, tuning::Param::NMS_THRESHOLD,
+                                     tuning::Param::OCR_LINK_THRESHOLD, tuning::Param::OCR_SEGMENTATION_THRESHOLD };
+    for (const auto &param : params)
+    {
+        const std::string name = tuning::to_string(param);
+        if (json_object_dotget_value(root_object, ("desired." + name).c_str()) != nullptr)
+        {
+            update_tuning_param(param, json_object_dotget_value(root_object, ("desired." + name).c_str()));
+        }
+        if (json_object_get_value(root_object, name.c_str()) != nullptr)
+        {
+            update_tuning_param(param, json_object_get_value(root_object, name.c_str()));
+        }
+    }
+}
+
 /** This is the callback for when the module twin changes. */
 static void module_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char *payload, size_t size, void *user_context_cb)
 {
@@ -411,6 +477,8 @@ static void module_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state, const un
     parse_model_update(root_object);
     parse_streams(root_object);
     parse_time_alignment(root_object);
+    parse_time_alignment_storage(root_object);
+    parse_tuning(root_object);
 }
 
 void restart_model_with_new_resolution(const rtsp::Resolution &resolution)
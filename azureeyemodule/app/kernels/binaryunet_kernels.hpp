@@ -2,6 +2,8 @@
 // Licensed under the MIT license.
 #pragma once
 
+#include <cstring>
+
 #include <opencv2/gapi/mx.hpp>
 #include <opencv2/gapi/cpu/gcpukernel.hpp>
 #include <opencv2/core/utility.hpp>
@@ -11,24 +13,32 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/gapi/streaming/desync.hpp>
 
+#include "tensor.hpp"
+
 namespace cv {
 namespace gapi {
 namespace streaming {
 
 G_API_OP(PostProcBinaryUnet, <cv::GMat(cv::GMat)>, "custom.unet_postproc_1channel")
 {
-  static cv::GMatDesc outMeta(const cv::GMatDesc &)
+  static cv::GMatDesc outMeta(const cv::GMatDesc &in)
   {
     // This function is required for G-API engine to figure out
     // what the output format is, given the input parameters.
-    return cv::GMatDesc(CV_32F, 1, {408, 308});
+    // The network gives us a 1x1xHxW tensor, and we give back an HxW single channel image.
+    GAPI_Assert(in.dims.size() == 4U);
+    return cv::GMatDesc(CV_32F, 1, cv::Size(in.dims[3], in.dims[2]));
   }
 };
 
 /**
  * Kernel for the above op.
  *
- * We receive a 1x1x408x308 tensor and need to convert it to a 408x308 cv::Mat.
+ * We receive a 1x1xHxW tensor and need to convert it to an HxW cv::Mat.
+ *
+ * G-API hands us the output already allocated (and won't let us swap in a view of the input instead),
+ * so the best we can do is a block copy: one memcpy if the tensor is contiguous, one per row otherwise.
+ * FP16 and U8 tensors are widened to floats on the way instead.
  */
 GAPI_OCV_KERNEL(GOCVPostProcBinaryUnet, PostProcBinaryUnet)
 {
@@ -36,25 +46,33 @@ GAPI_OCV_KERNEL(GOCVPostProcBinaryUnet, PostProcBinaryUnet)
   {
     const auto &in_mask_dims = in_mask.size;
 
-    assert(in_mask_dims.dims() == 4U);
+    GAPI_Assert(in_mask_dims.dims() == 4);
+    GAPI_Assert(tensor::is_supported_depth(in_mask.depth()));
 
-    //size_t channels = in_mask_dims[1];
-    size_t height = in_mask_dims[2];
-    size_t width = in_mask_dims[3];
+    const int height = in_mask_dims[2];
+    const int width = in_mask_dims[3];
+    GAPI_Assert(out_mask.rows == height && out_mask.cols == width && out_mask.type() == CV_32F);
 
-    const float *data = in_mask.ptr<float>();
-    // row-major layout of Mat object
-    size_t step_h = in_mask.step[2] / sizeof(float);
-    size_t step_w = in_mask.step[3] / sizeof(float);
-
-    //populate the output
-    for (size_t row = 0; row < height; row++)
+    if (in_mask.depth() != CV_32F)
     {
-      for (size_t col = 0; col < width; col++)
+      for (int row = 0; row < height; row++)
       {
-        float val = *(data + step_h * row + step_w * col);
-        out_mask.at<float>(row, col) = val;
+        tensor::widen(in_mask, static_cast<size_t>(row) * width, width, out_mask.ptr<float>(row));
       }
+      return;
+    }
+
+    const size_t row_bytes = static_cast<size_t>(width) * sizeof(float);
+    if (in_mask.isContinuous() && out_mask.isContinuous())
+    {
+      std::memcpy(out_mask.ptr<float>(), in_mask.ptr<float>(), row_bytes * height);
+      return;
+    }
+
+    // The innermost dimension of a cv::Mat is always dense, so each row can still go in one copy.
+    for (int row = 0; row < height; row++)
+    {
+      std::memcpy(out_mask.ptr<float>(row), in_mask.ptr<float>(0, 0, row), row_bytes);
     }
   }
 };
@@ -17,9 +17,9 @@ namespace gapi {
 namespace streaming {
 
 /** C++ wrapper for classification op */
-GClassificationsWithConf parse_class(const GMat& in)
+GClassificationsWithConf parse_class(const GMat& in, int top_k, bool apply_softmax, float confidence_threshold)
 {
-    return GParseClass::on(in);
+    return GParseClass::on(in, top_k, apply_softmax, confidence_threshold);
 }
 
 } // namespace streaming
@@ -2,6 +2,13 @@
 // Licensed under the MIT license.
 #pragma once
 
+// Standard library includes
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+// Third party includes
 #include <opencv2/gapi/mx.hpp>
 #include <opencv2/gapi/cpu/gcpukernel.hpp>
 #include <opencv2/core/utility.hpp>
@@ -11,6 +18,10 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/gapi/streaming/desync.hpp>
 
+// Local includes
+#include "tensor.hpp"
+#include "tuning.hpp"
+
 namespace cv {
 namespace gapi {
 namespace streaming {
@@ -18,10 +29,10 @@ namespace streaming {
 /** A classifier returns a one-hot integer label ID vector and the confidences. */
 using GClassificationsWithConf = std::tuple<GArray<int>, GArray<float>>;
 
-/** Classification op */
-G_API_OP(GParseClass, <GClassificationsWithConf(GMat)>, "org.opencv.dnn.parseClass")
+/** Classification op. Takes the network output, K (non-positive means all classes), whether to apply softmax, and a confidence threshold. */
+G_API_OP(GParseClass, <GClassificationsWithConf(GMat, int, bool, float)>, "org.opencv.dnn.parseClass")
 {
-    static std::tuple<GArrayDesc, GArrayDesc> outMeta(const GMatDesc&)
+    static std::tuple<GArrayDesc, GArrayDesc> outMeta(const GMatDesc&, int, bool, float)
     {
         return std::make_tuple(empty_array_desc(), empty_array_desc());
     }
@@ -30,27 +41,77 @@ G_API_OP(GParseClass, <GClassificationsWithConf(GMat)>, "org.opencv.dnn.parseCla
 /** Kernel implementation of classification op */
 GAPI_OCV_KERNEL(GOCVParseClass, GParseClass)
 {
-    static void run(const Mat &in_result, std::vector<int> &out_labels, std::vector<float> &out_confidences)
+    static void run(const Mat &in_result, int top_k, bool apply_softmax, float confidence_threshold, std::vector<int> &out_labels, std::vector<float> &out_confidences)
     {
         const auto& in_dims = in_result.size;
 
         // We expect a Tensor of shape (1, 1, 1, N)
         CV_Assert(in_dims.dims() == 4);
+        CV_Assert(in_result.isContinuous());
 
         out_labels.clear();
         out_confidences.clear();
+        confidence_threshold = tuning::get(tuning::Param::CONFIDENCE_THRESHOLD, confidence_threshold);
+
+        // Every score gets read, so lower precision outputs are widened in full.
+        static thread_local std::vector<float> widened;
+        const float *results = tensor::as_float(in_result, widened);
+        const int n_classes = in_dims[3];
+        if (n_classes <= 0)
+        {
+            return;
+        }
 
-        const auto results = in_result.ptr<float>();
-        for (int i = 0; i < in_dims[3]; i++)
+        // Softmax is monotonic, so we can select on the raw scores and only normalize the few that we keep.
+        float max_score = results[0];
+        float sum = 1.0f;
+        if (apply_softmax)
         {
-            out_labels.emplace_back(i);
-            out_confidences.emplace_back(results[i]);
+            max_score = *std::max_element(results, results + n_classes);
+            sum = 0.0f;
+            for (int i = 0; i < n_classes; i++)
+            {
+                sum += std::exp(results[i] - max_score);
+            }
+        }
+
+        // Partially sort the class indexes so that only the top K are ordered (by descending score, ties by index).
+        static thread_local std::vector<int> indexes;
+        indexes.resize(n_classes);
+        std::iota(indexes.begin(), indexes.end(), 0);
+        const int k = ((top_k <= 0) || (top_k > n_classes)) ? n_classes : top_k;
+        std::partial_sort(indexes.begin(), indexes.begin() + k, indexes.end(), [results](int a, int b)
+        {
+            return (results[a] > results[b]) || ((results[a] == results[b]) && (a < b));
+        });
+
+        out_labels.reserve(k);
+        out_confidences.reserve(k);
+        for (int i = 0; i < k; i++)
+        {
+            const int label = indexes[i];
+            const float confidence = apply_softmax ? std::exp(results[label] - max_score) / sum : results[label];
+            if (confidence < confidence_threshold)
+            {
+                // The rest are sorted below this one, so they can't make it either.
+                break;
+            }
+
+            out_labels.emplace_back(label);
+            out_confidences.emplace_back(confidence);
         }
     }
 };
 
-/** C++ wrapper for classification op */
-GAPI_EXPORTS GClassificationsWithConf parse_class(const GMat& in);
+/**
+ * C++ wrapper for classification op.
+ *
+ * @param in: The network output, of shape (1, 1, 1, N).
+ * @param top_k: Only output this many classes, most confident first. Non-positive means output all of them.
+ * @param apply_softmax: If true, the network outputs raw scores and we convert them to probabilities.
+ * @param confidence_threshold: Classes whose confidence is below this are dropped.
+ */
+GAPI_EXPORTS GClassificationsWithConf parse_class(const GMat& in, int top_k = 0, bool apply_softmax = false, float confidence_threshold = 0.0f);
 
 } // namespace streaming
 } // namespace gapi
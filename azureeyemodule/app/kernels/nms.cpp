@@ -0,0 +1,283 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// Standard libary includes
+#include <algorithm>
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+// Local includes
+#include "nms.hpp"
+
+namespace nms {
+
+/** A set of boxes stored as a structure of arrays, so that IoUs against them can be computed in batches. */
+struct BoxBatch
+{
+    std::vector<float> x1;
+    std::vector<float> y1;
+    std::vector<float> x2;
+    std::vector<float> y2;
+    std::vector<float> area;
+
+    void clear()
+    {
+        this->x1.clear();
+        this->y1.clear();
+        this->x2.clear();
+        this->y2.clear();
+        this->area.clear();
+    }
+
+    void push(float bx1, float by1, float bx2, float by2, float barea)
+    {
+        this->x1.push_back(bx1);
+        this->y1.push_back(by1);
+        this->x2.push_back(bx2);
+        this->y2.push_back(by2);
+        this->area.push_back(barea);
+    }
+
+    int size() const
+    {
+        return static_cast<int>(this->x1.size());
+    }
+};
+
+/** Orders detections by descending confidence. */
+static inline bool more_confident(const Detection &a, const Detection &b)
+{
+    return a.conf > b.conf;
+}
+
+/** Returns true if the given box has an IoU greater than `threshold` with any box in the batch. */
+static bool overlaps_any(const cv::Rect &rect, const BoxBatch &batch, float threshold)
+{
+    const float bx1 = static_cast<float>(rect.x);
+    const float by1 = static_cast<float>(rect.y);
+    const float bx2 = static_cast<float>(rect.x + rect.width);
+    const float by2 = static_cast<float>(rect.y + rect.height);
+    const float barea = static_cast<float>(rect.area());
+    const int n = batch.size();
+    int i = 0;
+
+    // IoU > t  <=>  intersection > t * union, which saves us a division per pair.
+#if CV_SIMD
+    constexpr int lanes = cv::v_float32::nlanes;
+    const cv::v_float32 v_bx1 = cv::vx_setall_f32(bx1);
+    const cv::v_float32 v_by1 = cv::vx_setall_f32(by1);
+    const cv::v_float32 v_bx2 = cv::vx_setall_f32(bx2);
+    const cv::v_float32 v_by2 = cv::vx_setall_f32(by2);
+    const cv::v_float32 v_barea = cv::vx_setall_f32(barea);
+    const cv::v_float32 v_threshold = cv::vx_setall_f32(threshold);
+    const cv::v_float32 v_zero = cv::vx_setzero_f32();
+    for (; i <= n - lanes; i += lanes)
+    {
+        const cv::v_float32 w = cv::v_max(cv::v_min(v_bx2, cv::vx_load(&batch.x2[i])) - cv::v_max(v_bx1, cv::vx_load(&batch.x1[i])), v_zero);
+        const cv::v_float32 h = cv::v_max(cv::v_min(v_by2, cv::vx_load(&batch.y2[i])) - cv::v_max(v_by1, cv::vx_load(&batch.y1[i])), v_zero);
+        const cv::v_float32 intersection = w * h;
+        const cv::v_float32 area_union = v_barea + cv::vx_load(&batch.area[i]) - intersection;
+        if (cv::v_signmask(intersection > v_threshold * area_union) != 0)
+        {
+            return true;
+        }
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        const float w = std::max(std::min(bx2, batch.x2[i]) - std::max(bx1, batch.x1[i]), 0.0f);
+        const float h = std::max(std::min(by2, batch.y2[i]) - std::max(by1, batch.y1[i]), 0.0f);
+        const float intersection = w * h;
+        if (intersection > threshold * (barea + batch.area[i] - intersection))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Greedy NMS over one partition of candidates, which must already be sorted by descending confidence.
+ * Survivors are appended to `kept`.
+ */
+static void suppress_partition(std::vector<Detection>::const_iterator begin, std::vector<Detection>::const_iterator end, float threshold, std::vector<Detection> &kept)
+{
+    if (begin == end)
+    {
+        return;
+    }
+    else if (threshold >= 1.0f)
+    {
+        kept.insert(kept.end(), begin, end);
+        return;
+    }
+
+    // Size the grid so that a typical box covers about one cell, but don't let it have many more cells than boxes.
+    const size_t n = static_cast<size_t>(end - begin);
+    int min_x = begin->rect.x;
+    int min_y = begin->rect.y;
+    int max_x = begin->rect.x + begin->rect.width;
+    int max_y = begin->rect.y + begin->rect.height;
+    double mean_extent = 0.0;
+    for (auto it = begin; it != end; ++it)
+    {
+        min_x = std::min(min_x, it->rect.x);
+        min_y = std::min(min_y, it->rect.y);
+        max_x = std::max(max_x, it->rect.x + it->rect.width);
+        max_y = std::max(max_y, it->rect.y + it->rect.height);
+        mean_extent += std::max(it->rect.width, it->rect.height);
+    }
+
+    int cell = std::max(1, static_cast<int>(mean_extent / n));
+    const size_t max_cells = std::max<size_t>(64, 4 * n);
+    int cols = (max_x - min_x) / cell + 1;
+    int rows = (max_y - min_y) / cell + 1;
+    while (static_cast<size_t>(cols) * rows > max_cells)
+    {
+        cell *= 2;
+        cols = (max_x - min_x) / cell + 1;
+        rows = (max_y - min_y) / cell + 1;
+    }
+
+    // Each cell lists the indexes of the kept boxes that cover it. The grid and batches are scratch space, kept across
+    // partitions and frames (cleared, not freed) so that we don't reallocate them on every inference.
+    static thread_local std::vector<std::vector<int>> grid;
+    static thread_local BoxBatch kept_boxes;
+    static thread_local BoxBatch neighbors;
+    static thread_local std::vector<int> last_seen;
+
+    const size_t n_cells = static_cast<size_t>(cols) * rows;
+    if (grid.size() < n_cells)
+    {
+        grid.resize(n_cells);
+    }
+    for (size_t c = 0; c < n_cells; c++)
+    {
+        grid[c].clear();
+    }
+    kept_boxes.clear();
+    last_seen.clear();
+
+    for (auto it = begin; it != end; ++it)
+    {
+        const cv::Rect &rect = it->rect;
+        const int col0 = (rect.x - min_x) / cell;
+        const int row0 = (rect.y - min_y) / cell;
+        const int col1 = std::max(col0, (rect.x + rect.width - 1 - min_x) / cell);
+        const int row1 = std::max(row0, (rect.y + rect.height - 1 - min_y) / cell);
+        const int stamp = static_cast<int>(it - begin);
+
+        // Gather every kept box that shares a cell with this one (once each) into a batch.
+        neighbors.clear();
+        for (int row = row0; row <= row1; row++)
+        {
+            for (int col = col0; col <= col1; col++)
+            {
+                for (auto k : grid[static_cast<size_t>(row) * cols + col])
+                {
+                    if (last_seen[k] != stamp)
+                    {
+                        last_seen[k] = stamp;
+                        neighbors.push(kept_boxes.x1[k], kept_boxes.y1[k], kept_boxes.x2[k], kept_boxes.y2[k], kept_boxes.area[k]);
+                    }
+                }
+            }
+        }
+
+        if (overlaps_any(rect, neighbors, threshold))
+        {
+            continue;
+        }
+
+        const int k = kept_boxes.size();
+        kept_boxes.push(static_cast<float>(rect.x), static_cast<float>(rect.y), static_cast<float>(rect.x + rect.width), static_cast<float>(rect.y + rect.height), static_cast<float>(rect.area()));
+        last_seen.push_back(stamp);
+        for (int row = row0; row <= row1; row++)
+        {
+            for (int col = col0; col <= col1; col++)
+            {
+                grid[static_cast<size_t>(row) * cols + col].push_back(k);
+            }
+        }
+
+        kept.push_back(*it);
+    }
+}
+
+void suppress(std::vector<Detection> &detections, const Params &params)
+{
+    if (detections.empty())
+    {
+        return;
+    }
+
+    // Partition by class with a counting sort, so that each class is one contiguous range.
+    int min_label = 0;
+    int max_label = 0;
+    if (params.class_aware)
+    {
+        min_label = detections.front().label;
+        max_label = detections.front().label;
+        for (const auto &d : detections)
+        {
+            min_label = std::min(min_label, d.label);
+            max_label = std::max(max_label, d.label);
+        }
+    }
+
+    // Scratch space, kept across frames so that we don't reallocate it on every inference.
+    static thread_local std::vector<size_t> offsets;
+    static thread_local std::vector<size_t> cursor;
+    static thread_local std::vector<Detection> partitioned;
+    static thread_local std::vector<Detection> kept;
+
+    const size_t n_partitions = static_cast<size_t>(max_label - min_label) + 1;
+    offsets.assign(n_partitions + 1, 0);
+    for (const auto &d : detections)
+    {
+        offsets[(params.class_aware ? d.label - min_label : 0) + 1]++;
+    }
+    for (size_t p = 0; p < n_partitions; p++)
+    {
+        offsets[p + 1] += offsets[p];
+    }
+
+    partitioned.resize(detections.size());
+    cursor.assign(offsets.begin(), offsets.end() - 1);
+    for (const auto &d : detections)
+    {
+        partitioned[cursor[params.class_aware ? d.label - min_label : 0]++] = d;
+    }
+
+    kept.clear();
+    for (size_t p = 0; p < n_partitions; p++)
+    {
+        auto begin = partitioned.begin() + offsets[p];
+        auto end = partitioned.begin() + offsets[p + 1];
+
+        // Cap the partition to its top K before paying for a full sort.
+        if ((params.top_k > 0) && (static_cast<size_t>(end - begin) > params.top_k))
+        {
+            std::nth_element(begin, begin + params.top_k, end, more_confident);
+            end = begin + params.top_k;
+        }
+
+        std::stable_sort(begin, end, more_confident);
+        suppress_partition(begin, end, params.iou_threshold, kept);
+    }
+
+    if (n_partitions > 1)
+    {
+        std::stable_sort(kept.begin(), kept.end(), more_confident);
+    }
+
+    // Copy rather than swap, so that callers who keep `detections` around across frames keep its capacity.
+    detections.assign(kept.begin(), kept.end());
+}
+
+} // namespace nms
@@ -0,0 +1,46 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+
+// Standard libary includes
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+
+namespace nms {
+
+/** A single candidate box for non-maximum suppression. */
+struct Detection
+{
+    cv::Rect rect;
+    float    conf;
+    int      label;
+};
+
+/** Knobs for `suppress()`. */
+struct Params
+{
+    /** A box is suppressed if its IoU with a more confident kept box is greater than this. 1.0 disables suppression. */
+    float iou_threshold = 0.5f;
+
+    /** Only the `top_k` most confident candidates of each class are considered. Zero means no cap. */
+    size_t top_k = 200;
+
+    /** If true, boxes only suppress boxes of the same class. Otherwise every box competes with every other box. */
+    bool class_aware = true;
+};
+
+/**
+ * Greedy non-maximum suppression.
+ *
+ * Candidates are partitioned by class (if `params.class_aware`) and capped to the top K of each class before sorting.
+ * Each kept box is then filed into the cells of a uniform grid that it covers, so that a new candidate only has to be
+ * compared against the kept boxes in its own cells. Those comparisons are done as one batched (SIMD) IoU computation.
+ *
+ * @param detections: The candidates. On return, this holds only the kept boxes, sorted by descending confidence.
+ * @param params: The suppression parameters.
+ */
+void suppress(std::vector<Detection> &detections, const Params &params);
+
+} // namespace nms
@@ -7,9 +7,12 @@
 #pragma once
 
 // Standard library includes
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 //Third party includes
+#include <opencv2/core/hal/intrin.hpp>
 #include <opencv2/gapi.hpp>
 #include <opencv2/gapi/core.hpp>
 #include <opencv2/gapi/cpu/gcpukernel.hpp>
@@ -17,6 +20,10 @@
 #include <opencv2/gapi/streaming/cap.hpp>
 #include <opencv2/gapi/mx.hpp> // size()
 
+// Local includes
+#include "tensor.hpp"
+#include "tuning.hpp"
+
 namespace cv {
 namespace gapi {
 namespace streaming {
@@ -46,252 +53,237 @@ GAPI_OCV_KERNEL(OCVPostProcess, PostProcess)
 {
     static void run (const cv::Mat &link, const cv::Mat &segm, const cv::Size &img_size, const float link_threshold, const float segm_threshold, std::vector<cv::RotatedRect> &out)
     {
-        // NOTE: Taken from the OMZ text detection sample almost as-is
+        // NOTE: Derived from the OMZ text detection sample, but reads the NCHW tensors in place
+        //       rather than transposing them, applying softmax, and slicing out the positive channel.
         const int kMinArea = 300;
         const int kMinHeight = 10;
 
-        const float *link_data_pointer = link.ptr<float>();
-        std::vector<float> link_data(link_data_pointer, link_data_pointer + link.total());
-        link_data = transpose4d(link_data, dimsToShape(link.size), {0, 2, 3, 1});
-        softmax(link_data);
-        link_data = sliceAndGetSecondChannel(link_data);
-
-        std::vector<int> new_link_data_shape = {
-                link.size[0],
-                link.size[2],
-                link.size[3],
-                link.size[1]/2,
-        };
+        GAPI_Assert(segm.size.dims() == 4 && segm.size[1] == 2);
+        GAPI_Assert(link.size.dims() == 4 && link.size[1] % 2 == 0);
+        GAPI_Assert(link.size[2] == segm.size[2] && link.size[3] == segm.size[3]);
 
-        const float *cls_data_pointer = segm.ptr<float>();
-        std::vector<float> cls_data(cls_data_pointer, cls_data_pointer + segm.total());
-        cls_data = transpose4d(cls_data, dimsToShape(segm.size), {0, 2, 3, 1});
-        softmax(cls_data);
-        cls_data = sliceAndGetSecondChannel(cls_data);
-        std::vector<int> new_cls_data_shape = {
-                segm.size[0],
-                segm.size[2],
-                segm.size[3],
-                segm.size[1]/2,
-        };
+        // Every element of both tensors gets read, so lower precision outputs are widened in full.
+        static thread_local cv::Mat widened_segm;
+        static thread_local cv::Mat widened_link;
+        const cv::Mat &segm_f32 = tensor::as_float(segm, widened_segm);
+        const cv::Mat &link_f32 = tensor::as_float(link, widened_link);
 
-        out = maskToBoxes(decodeImageByJoin(cls_data, new_cls_data_shape, link_data, new_link_data_shape, segm_threshold, link_threshold),
-                                            static_cast<float>(kMinArea), static_cast<float>(kMinHeight), img_size);
+        // The component mask is reused from frame to frame.
+        static thread_local cv::Mat mask;
+        decodeImageByJoin(segm_f32, link_f32, tuning::get(tuning::Param::OCR_SEGMENTATION_THRESHOLD, segm_threshold),
+                          tuning::get(tuning::Param::OCR_LINK_THRESHOLD, link_threshold), mask);
+
+        out = maskToBoxes(mask, static_cast<float>(kMinArea), static_cast<float>(kMinHeight), img_size);
     }
 
-    static std::vector<std::size_t> dimsToShape(const cv::MatSize &sz)
+    /**
+     * The positive-class probability of a two-channel softmax is sigmoid(positive - negative),
+     * so it is at least `threshold` exactly when the logit difference is at least logit(threshold).
+     * This returns that logit, which lets us threshold the raw tensors without any exponentials.
+     */
+    static float logitThreshold(float threshold)
     {
-        const int n_dims = sz.dims();
-        std::vector<std::size_t> result;
-        result.reserve(n_dims);
-
-        // cv::MatSize is not iterable...
-        for (int i = 0; i < n_dims; i++)
-        {
-            result.emplace_back(static_cast<std::size_t>(sz[i]));
-        }
-        return result;
+        const float t = std::min(std::max(threshold, 1e-6f), 1.0f - 1e-6f);
+        return std::log(t / (1.0f - t));
     }
 
-    static void softmax(std::vector<float> &rdata)
+    static int findRoot(int point, std::vector<int> &parent)
     {
-        // NOTE: Taken from the OMZ text detection sample almost as-is
-        const size_t last_dim = 2;
-        for (size_t i = 0 ; i < rdata.size(); i+=last_dim)
+        // Path halving: every node we pass ends up pointing at its grandparent.
+        while (parent[point] != point)
         {
-            float m = std::max(rdata[i], rdata[i+1]);
-            rdata[i] = std::exp(rdata[i] - m);
-            rdata[i + 1] = std::exp(rdata[i + 1] - m);
-            float s = rdata[i] + rdata[i + 1];
-            rdata[i] /= s;
-            rdata[i + 1] /= s;
+            parent[point] = parent[parent[point]];
+            point = parent[point];
         }
+        return point;
     }
 
-    static std::vector<float> transpose4d(const std::vector<float> &data, const std::vector<size_t> &shape, const std::vector<size_t> &axes)
+    static void join(const int p1, const int p2, std::vector<int> &parent)
     {
-        // NOTE: Taken from the OMZ text detection sample almost as-is
-        if (shape.size() != axes.size())
-        {
-            throw std::runtime_error("Shape and axes must have the same dimension.");
-        }
-
-        for (size_t a : axes)
+        const int root1 = findRoot(p1, parent);
+        const int root2 = findRoot(p2, parent);
+        if (root1 != root2)
         {
-            if (a >= shape.size())
-            {
-                throw std::runtime_error("Axis must be less than dimension of shape.");
-            }
+            parent[root1] = root2;
         }
+    }
 
-        size_t total_size = shape[0]*shape[1]*shape[2]*shape[3];
-
-        std::vector<size_t> steps {
-            shape[axes[1]]*shape[axes[2]]*shape[axes[3]],
-            shape[axes[2]]*shape[axes[3]],
-            shape[axes[3]],
-            1
-        };
-
-        size_t source_data_idx = 0;
-        std::vector<float> new_data(total_size, 0);
-        std::vector<size_t> ids(shape.size());
-
-        for (ids[0] = 0; ids[0] < shape[0]; ids[0]++)
+    /**
+     * Thresholds the text/no-text segmentation and the eight-neighbor links, joins linked text pixels with
+     * a union-find over the h*w grid, and writes a CV_32S mask (0 for background, 1..N for the components,
+     * numbered in raster order) into `mask`.
+     */
+    static void decodeImageByJoin(const cv::Mat &segm, const cv::Mat &link, float cls_conf_threshold, float link_conf_threshold, cv::Mat &mask)
+    {
+        const int h = segm.size[2];
+        const int w = segm.size[3];
+        const int plane = h * w;
+        const int neighbours = link.size[1] / 2;
+
+        const float *cls_negative = segm.ptr<float>();
+        const float *cls_positive = cls_negative + plane;
+        const float *link_data = link.ptr<float>();
+        const float cls_logit = logitThreshold(cls_conf_threshold);
+        const float link_logit = logitThreshold(link_conf_threshold);
+
+        // parent[i] is -1 for background pixels, and the union-find parent of text pixels.
+        static thread_local std::vector<int> parent;
+        parent.assign(static_cast<size_t>(plane), -1);
+
+        int i = 0;
+#if CV_SIMD
+        constexpr int lanes = cv::v_float32::nlanes;
+        const cv::v_float32 v_cls_logit = cv::vx_setall_f32(cls_logit);
+        for (; i <= plane - lanes; i += lanes)
         {
-            for (ids[1] = 0; ids[1] < shape[1]; ids[1]++)
+            const cv::v_float32 diff = cv::vx_load(cls_positive + i) - cv::vx_load(cls_negative + i);
+            const int positive = cv::v_signmask(diff >= v_cls_logit);
+            for (int k = 0; positive != 0 && k < lanes; k++)
             {
-                for (ids[2] = 0; ids[2] < shape[2]; ids[2]++)
+                if (positive & (1 << k))
                 {
-                    for (ids[3]= 0; ids[3] < shape[3]; ids[3]++)
-                    {
-                        size_t new_data_idx = ids[axes[0]]*steps[0] + ids[axes[1]]*steps[1] + ids[axes[2]]*steps[2] + ids[axes[3]]*steps[3];
-                        new_data[new_data_idx] = data[source_data_idx++];
-                    }
+                    parent[i + k] = i + k;
                 }
             }
         }
-        return new_data;
-    }
-
-    static std::vector<float> sliceAndGetSecondChannel(const std::vector<float> &data)
-    {
-        // NOTE: Taken from the OMZ text detection sample almost as-is
-        std::vector<float> new_data(data.size() / 2, 0);
-        for (size_t i = 0; i < data.size() / 2; i++)
+#endif
+        for (; i < plane; i++)
         {
-            new_data[i] = data[2 * i + 1];
-        }
-        return new_data;
-    }
-
-    static void join(const int p1, const int p2, std::unordered_map<int, int> &group_mask)
-    {
-        // NOTE: Taken from the OMZ text detection sample almost as-is
-        const int root1 = findRoot(p1, group_mask);
-        const int root2 = findRoot(p2, group_mask);
-        if (root1 != root2)
-        {
-            group_mask[root1] = root2;
+            if (cls_positive[i] - cls_negative[i] >= cls_logit)
+            {
+                parent[i] = i;
+            }
         }
-    }
 
-    static cv::Mat decodeImageByJoin(const std::vector<float> &cls_data,
-                                     const std::vector<int>   &cls_data_shape,
-                                     const std::vector<float> &link_data,
-                                     const std::vector<int>   &link_data_shape,
-                                     float cls_conf_threshold,
-                                     float link_conf_threshold)
-    {
-        // NOTE: Taken from the OMZ text detection sample almost as-is
-        const int h = cls_data_shape[1];
-        const int w = cls_data_shape[2];
-
-        std::vector<uchar> pixel_mask(h * w, 0);
-        std::unordered_map<int, int> group_mask;
-        std::vector<cv::Point> points;
-        for (int i = 0; i < static_cast<int>(pixel_mask.size()); i++)
+        for (int p = 0; p < plane; p++)
         {
-            pixel_mask[i] = cls_data[i] >= cls_conf_threshold;
-            if (pixel_mask[i])
+            if (parent[p] < 0)
             {
-                points.emplace_back(i % w, i / w);
-                group_mask[i] = -1;
+                continue;
             }
-        }
-        std::vector<uchar> link_mask(link_data.size(), 0);
-        for (size_t i = 0; i < link_mask.size(); i++)
-        {
-            link_mask[i] = link_data[i] >= link_conf_threshold;
-        }
 
-        size_t neighbours = size_t(link_data_shape[3]);
-        for (const auto &point : points)
-        {
-            size_t neighbour = 0;
-            for (int ny = point.y - 1; ny <= point.y + 1; ny++)
+            const int x = p % w;
+            const int y = p / w;
+            int neighbour = 0;
+            for (int ny = y - 1; ny <= y + 1; ny++)
             {
-                for (int nx = point.x - 1; nx <= point.x + 1; nx++)
+                for (int nx = x - 1; nx <= x + 1; nx++)
                 {
-                    if (nx == point.x && ny == point.y)
+                    if (nx == x && ny == y)
                     {
                         continue;
                     }
 
-                    if (nx >= 0 && nx < w && ny >= 0 && ny < h)
+                    if (nx >= 0 && nx < w && ny >= 0 && ny < h && neighbour < neighbours)
                     {
-                        uchar pixel_value = pixel_mask[size_t(ny) * size_t(w) + size_t(nx)];
-                        uchar link_value = link_mask[(size_t(point.y) * size_t(w) + size_t(point.x)) *neighbours + neighbour];
-                        if (pixel_value && link_value)
+                        const int q = ny * w + nx;
+                        const float link_diff = link_data[(2 * neighbour + 1) * plane + p] - link_data[2 * neighbour * plane + p];
+                        if (parent[q] >= 0 && link_diff >= link_logit)
                         {
-                            join(point.x + point.y * w, nx + ny * w, group_mask);
+                            join(p, q, parent);
                         }
                     }
                     neighbour++;
                 }
             }
         }
-        return get_all(points, w, h, group_mask);
-    }
 
-    static cv::Mat get_all(const std::vector<cv::Point> &points, const int w, const int h, std::unordered_map<int, int> &group_mask)
-    {
-        // NOTE: Taken from the OMZ text detection sample almost as-is
-        std::unordered_map<int, int> root_map;
-        cv::Mat mask(h, w, CV_32S, cv::Scalar(0));
-        for (const auto &point : points)
+        // Number the components in the order we first meet them, which is how the old map-based version numbered them.
+        static thread_local std::vector<int> component;
+        component.assign(static_cast<size_t>(plane), 0);
+        mask.create(h, w, CV_32S);
+        int *mask_data = mask.ptr<int>();
+        int n_components = 0;
+        for (int p = 0; p < plane; p++)
         {
-            int point_root = findRoot(point.x + point.y * w, group_mask);
-            if (root_map.find(point_root) == root_map.end())
+            if (parent[p] < 0)
             {
-                root_map.emplace(point_root, static_cast<int>(root_map.size() + 1));
+                mask_data[p] = 0;
+                continue;
             }
-            mask.at<int>(point.x + point.y * w) = root_map[point_root];
-        }
-        return mask;
-    }
 
-    static int findRoot(const int point, std::unordered_map<int, int> &group_mask)
-    {
-        // NOTE: Taken from the OMZ text detection sample almost as-is
-        int root = point;
-        bool update_parent = false;
-        while (group_mask.at(root) != -1)
-        {
-            root = group_mask.at(root);
-            update_parent = true;
-        }
-
-        if (update_parent)
-        {
-            group_mask[point] = root;
+            const int root = findRoot(p, parent);
+            if (component[root] == 0)
+            {
+                component[root] = ++n_components;
+            }
+            mask_data[p] = component[root];
         }
-        return root;
     }
 
+    /**
+     * Turns the component mask into one rotated box (in image coordinates) per component.
+     *
+     * Rather than upscaling the mask to the image and running findContours once per component over the whole image,
+     * we make one pass over the low resolution mask. Each horizontal run of a component's pixels contributes the four
+     * image-space corners of the block it would cover once upscaled, which is all that the convex hull (and so
+     * minAreaRect) of the upscaled component depends on.
+     */
     static std::vector<cv::RotatedRect> maskToBoxes(const cv::Mat &mask, const float min_area, const float min_height, const cv::Size &image_size)
     {
-        // NOTE: Taken from the OMZ text detection sample almost as-is
         std::vector<cv::RotatedRect> bboxes;
         double min_val = 0.;
         double max_val = 0.;
         cv::minMaxLoc(mask, &min_val, &max_val);
-        int max_bbox_idx = static_cast<int>(max_val);
-        cv::Mat resized_mask;
-        cv::resize(mask, resized_mask, image_size, 0, 0, cv::INTER_NEAREST);
+        const int max_bbox_idx = static_cast<int>(max_val);
+        if (max_bbox_idx <= 0)
+        {
+            return bboxes;
+        }
 
-        for (int i = 1; i <= max_bbox_idx; i++)
+        const float scale_x = static_cast<float>(image_size.width) / static_cast<float>(mask.cols);
+        const float scale_y = static_cast<float>(image_size.height) / static_cast<float>(mask.rows);
+
+        // Per-component point lists, reused from frame to frame.
+        static thread_local std::vector<std::vector<cv::Point2f>> component_points;
+        if (component_points.size() < static_cast<size_t>(max_bbox_idx))
+        {
+            component_points.resize(static_cast<size_t>(max_bbox_idx));
+        }
+        for (int i = 0; i < max_bbox_idx; i++)
         {
-            cv::Mat bbox_mask = resized_mask == i;
-            std::vector<std::vector<cv::Point>> contours;
+            component_points[static_cast<size_t>(i)].clear();
+        }
+
+        for (int y = 0; y < mask.rows; y++)
+        {
+            const int *row = mask.ptr<int>(y);
+            const float top = y * scale_y;
+            const float bottom = (y + 1) * scale_y - 1.0f;
+            int x = 0;
+            while (x < mask.cols)
+            {
+                const int label = row[x];
+                const int run_start = x;
+                while (x < mask.cols && row[x] == label)
+                {
+                    x++;
+                }
+
+                if (label <= 0)
+                {
+                    continue;
+                }
+
+                const float left = run_start * scale_x;
+                const float right = x * scale_x - 1.0f;
+                auto &points = component_points[static_cast<size_t>(label - 1)];
+                points.emplace_back(left, top);
+                points.emplace_back(right, top);
+                points.emplace_back(left, bottom);
+                points.emplace_back(right, bottom);
+            }
+        }
 
-            cv::findContours(bbox_mask, contours, cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE);
-            if (contours.empty())
+        for (int i = 0; i < max_bbox_idx; i++)
+        {
+            const auto &points = component_points[static_cast<size_t>(i)];
+            if (points.empty())
             {
                 continue;
             }
 
-            cv::RotatedRect r = cv::minAreaRect(contours[0]);
+            cv::RotatedRect r = cv::minAreaRect(points);
             if (std::min(r.size.width, r.size.height) < min_height)
             {
                 continue;
@@ -311,16 +303,35 @@ GAPI_OCV_KERNEL(OCVCropLabels, CropLabels)
 {
     static void run(const cv::Mat &image, const std::vector<cv::RotatedRect> &detections, const cv::Size &outSize, std::vector<cv::Mat> &out)
     {
+        GAPI_Assert(image.type() == CV_8UC3);
+
         out.clear();
-        out.reserve(detections.size());
-        cv::Mat crop(outSize, CV_8UC3, cv::Scalar(0));
-        cv::Mat gray(outSize, CV_8UC1, cv::Scalar(0));
-        std::vector<int> blob_shape = {1,1,outSize.height,outSize.width};
+        if (detections.empty())
+        {
+            return;
+        }
 
-        for (auto &&rr : detections)
+        const int n_crops = static_cast<int>(detections.size());
+        const int crop_area = outSize.area();
+
+        // All the crops live in one N x (H * W) float arena, which we reuse from frame to frame.
+        // The crops we hand out are views into it, so if anything downstream is still holding on to
+        // last frame's crops, we leave it to them and start a new arena.
+        static thread_local cv::Mat arena;
+        const bool arena_in_use = (arena.u != nullptr) && (arena.u->refcount > 1);
+        if (arena_in_use || (arena.rows < n_crops) || (arena.cols != crop_area))
+        {
+            const int rows = ((arena.cols == crop_area) ? std::max(n_crops, arena.rows) : n_crops);
+            arena.release();
+            arena.create(rows, crop_area, CV_32F);
+        }
+
+        // Work out each crop's destination-to-source mapping up front. This is cheap; the sampling is what we parallelize.
+        std::vector<cv::Mat> inverse_transforms(detections.size());
+        for (size_t i = 0; i < detections.size(); i++)
         {
             std::vector<cv::Point2f> points(4);
-            rr.points(points.data());
+            detections[i].points(points.data());
 
             const auto top_left_point_idx = topLeftPointIdx(points);
             cv::Point2f point0 = points[static_cast<size_t>(top_left_point_idx)];
@@ -335,12 +346,85 @@ GAPI_OCV_KERNEL(OCVCropLabels, CropLabels)
                             static_cast<float>(outSize.height-1))
             };
             cv::Mat M = cv::getAffineTransform(from, to);
-            cv::warpAffine(image, crop, M, outSize);
-            cv::cvtColor(crop, gray, cv::COLOR_BGR2GRAY);
+            cv::invertAffineTransform(M, inverse_transforms[i]);
+        }
 
-            cv::Mat blob = gray;
-            gray.convertTo(blob, CV_32F);
-            out.push_back(blob.reshape(1, blob_shape)); // pass as 1,1,H,W instead of H,W
+        cv::parallel_for_(cv::Range(0, n_crops), [&](const cv::Range &range)
+        {
+            for (int i = range.start; i < range.end; i++)
+            {
+                warpToGray(image, inverse_transforms[static_cast<size_t>(i)], outSize, arena.ptr<float>(i));
+            }
+        });
+
+        std::vector<int> blob_shape = {1,1,outSize.height,outSize.width};
+        out.reserve(detections.size());
+        for (int i = 0; i < n_crops; i++)
+        {
+            out.push_back(arena.row(i).reshape(1, blob_shape)); // pass as 1,1,H,W instead of H,W
+        }
+    }
+
+    /**
+     * Does what warpAffine (bilinear, zero border), cvtColor(BGR2GRAY), and convertTo(CV_32F) would do, in one pass,
+     * writing the crop straight into `dst`. `inverse` is the 2x3 CV_64F mapping from crop to image coordinates.
+     */
+    static void warpToGray(const cv::Mat &image, const cv::Mat &inverse, const cv::Size &outSize, float *dst)
+    {
+        const double *m = inverse.ptr<double>();
+        const int max_x = image.cols - 1;
+        const int max_y = image.rows - 1;
+
+        // Fetches one BGR pixel, or black if it is off the image.
+        auto pixel = [&](int x, int y, int channel) -> float
+        {
+            if (x < 0 || y < 0 || x > max_x || y > max_y)
+            {
+                return 0.0f;
+            }
+            return static_cast<float>(image.ptr<uchar>(y)[3 * x + channel]);
+        };
+
+        for (int y = 0; y < outSize.height; y++)
+        {
+            for (int x = 0; x < outSize.width; x++)
+            {
+                const float sx = static_cast<float>(m[0] * x + m[1] * y + m[2]);
+                const float sy = static_cast<float>(m[3] * x + m[4] * y + m[5]);
+                const int x0 = cvFloor(sx);
+                const int y0 = cvFloor(sy);
+                const float fx = sx - x0;
+                const float fy = sy - y0;
+
+                float bgr[3];
+                if (x0 >= 0 && y0 >= 0 && x0 < max_x && y0 < max_y)
+                {
+                    // Fast path: all four taps are on the image.
+                    const uchar *row0 = image.ptr<uchar>(y0) + 3 * x0;
+                    const uchar *row1 = image.ptr<uchar>(y0 + 1) + 3 * x0;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        const float top = row0[c] + fx * (row0[3 + c] - row0[c]);
+                        const float bottom = row1[c] + fx * (row1[3 + c] - row1[c]);
+                        bgr[c] = top + fy * (bottom - top);
+                    }
+                }
+                else
+                {
+                    for (int c = 0; c < 3; c++)
+                    {
+                        const float top = pixel(x0, y0, c) + fx * (pixel(x0 + 1, y0, c) - pixel(x0, y0, c));
+                        const float bottom = pixel(x0, y0 + 1, c) + fx * (pixel(x0 + 1, y0 + 1, c) - pixel(x0, y0 + 1, c));
+                        bgr[c] = top + fy * (bottom - top);
+                    }
+                }
+
+                // Round like the 8-bit warp and conversion did, so the recognizer sees the same kind of input as before.
+                const float b = static_cast<float>(cv::saturate_cast<uchar>(bgr[0]));
+                const float g = static_cast<float>(cv::saturate_cast<uchar>(bgr[1]));
+                const float r = static_cast<float>(cv::saturate_cast<uchar>(bgr[2]));
+                dst[y * outSize.width + x] = static_cast<float>(cv::saturate_cast<uchar>(0.114f * b + 0.587f * g + 0.299f * r));
+            }
         }
     }
 
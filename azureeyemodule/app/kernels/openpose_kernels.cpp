@@ -16,6 +16,7 @@
 // Local includes
 #include "openpose_kernels.hpp"
 #include "../openpose/peak.hpp"
+#include "../openpose/upsampled_map.hpp"
 
 namespace cv {
 namespace gapi {
@@ -26,7 +27,7 @@ GPoses parse_open_pose(const GMat &pafs, const GMat &keys, const GOpaque<Size> &
     return GParseOpenPose::on(pafs, keys, in_sz);
 }
 
-void extract_poses(const std::vector<cv::Mat> &heat_maps, const std::vector<cv::Mat> &pafs, std::vector<pose::HumanPose> &poses,
+void extract_poses(const std::vector<pose::UpsampledMap> &heat_maps, const std::vector<pose::UpsampledMap> &pafs, std::vector<pose::HumanPose> &poses,
                    const float min_peaks_distance, const size_t keypoints_number, const float mid_points_score_threshold,
                    const float found_mid_points_ratio_threshold, const int min_joints_number, const float min_subset_score)
 {
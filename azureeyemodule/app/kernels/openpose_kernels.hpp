@@ -16,6 +16,8 @@
 // Local includes
 #include "../openpose/human_pose.hpp"
 #include "../openpose/peak.hpp"
+#include "../openpose/upsampled_map.hpp"
+#include "tensor.hpp"
 
 namespace cv {
 namespace gapi {
@@ -35,7 +37,7 @@ public:
      * @param peaks_from_heatmap: We will fill this with the peaks. Each item in the outer vector
      *                            is a list of peaks (possible key points) for a corresponding heat map.
      */
-    FindPeaksBody(const std::vector<cv::Mat> &heat_maps, float min_peaks_distance, std::vector<std::vector<pose::peak::Peak>> &peaks_from_heatmap)
+    FindPeaksBody(const std::vector<pose::UpsampledMap> &heat_maps, float min_peaks_distance, std::vector<std::vector<pose::peak::Peak>> &peaks_from_heatmap)
         : heat_maps(heat_maps), min_peaks_distance(min_peaks_distance), peaks_from_heatmap(peaks_from_heatmap)
     {
         // Nothing to do
@@ -51,7 +53,7 @@ public:
 
 private:
     /** The heat maps (key points) */
-    const std::vector<cv::Mat> &heat_maps;
+    const std::vector<pose::UpsampledMap> &heat_maps;
     /** Peaks in heat maps must be at least this far away in order to be counted as separate. */
     float min_peaks_distance;
     /** All peaks in a heat map, for each heat map */
@@ -80,8 +82,8 @@ GAPI_EXPORTS GPoses parse_open_pose(const GMat &pafs, const GMat &keys, const GO
 /**
  * Fills `poses` with the skeletons - one for each person in the image.
  *
- * @param heat_maps: The heat maps in vector of heat maps form.
- * @param pafs: The part affinity fields in vector of PAFs form.
+ * @param heat_maps: The heat maps in vector of heat maps form, upsampled on demand.
+ * @param pafs: The part affinity fields in vector of PAFs form, upsampled on demand.
  * @param poses: A vector of poses we will fill.
  * @param min_peaks_distance: The minimum distance between peaks (keypoints) for us to consider them different peaks.
  * @param keypoints_number: The number of keypoints in a skeleton.
@@ -90,7 +92,7 @@ GAPI_EXPORTS GPoses parse_open_pose(const GMat &pafs, const GMat &keys, const GO
  * @param min_joints_number: The minimum number of joints to be considered a pose.
  * @param min_subset_score:
  */
-void extract_poses(const std::vector<cv::Mat> &heat_maps, const std::vector<cv::Mat> &pafs, std::vector<pose::HumanPose> &poses,
+void extract_poses(const std::vector<pose::UpsampledMap> &heat_maps, const std::vector<pose::UpsampledMap> &pafs, std::vector<pose::HumanPose> &poses,
                    const float min_peaks_distance, const size_t keypoints_number, const float mid_points_score_threshold,
                    const float found_mid_points_ratio_threshold, const int min_joints_number, const float min_subset_score);
 
@@ -102,18 +104,24 @@ void correct_coordinates(std::vector<pose::HumanPose> &poses, const cv::Size &fe
 /**
  * Kernel implementation for OpenPose parsing.
  *
- * @param in_pafs: A rank 4 tensor of shape [1, 38, 32, 57]
- * @param in_keys: A rank 4 tensor of shape [1, 19, 32, 57]
+ * @param in_raw_pafs: A rank 4 tensor of shape [1, 38, 32, 57]. May be FP32, FP16, or U8.
+ * @param in_raw_keys: A rank 4 tensor of shape [1, 19, 32, 57]. May be FP32, FP16, or U8.
  * @param in_size: A Size type detailing the dimensions of the image.
  * @param out_poses: A vector of Poses that we return.
  */
 GAPI_OCV_KERNEL(GOCVParseOpenPose, GParseOpenPose)
 {
-    static void run(const Mat &in_pafs, const Mat &in_keys, const Size &in_size, std::vector<pose::HumanPose> &out_poses)
+    static void run(const Mat &in_raw_pafs, const Mat &in_raw_keys, const Size &in_size, std::vector<pose::HumanPose> &out_poses)
     {
         // Clear the poses to make room for this time.
         out_poses.clear();
 
+        // The maps get read all over (the peak search bounds every cell), so lower precision outputs are widened in full.
+        static thread_local cv::Mat widened_pafs;
+        static thread_local cv::Mat widened_keys;
+        const cv::Mat &in_pafs = tensor::as_float(in_raw_pafs, widened_pafs);
+        const cv::Mat &in_keys = tensor::as_float(in_raw_keys, widened_keys);
+
 #ifndef NDEBUG
         /** Dimensions we expect in_pafs to be */
         int paf_sizes[] = {1, 38, 32, 57};
@@ -180,36 +188,34 @@ GAPI_OCV_KERNEL(GOCVParseOpenPose, GParseOpenPose)
         assert(reshaped_pafs.size[2] == in_pafs.size[3]);
 #endif
 
-        // Create a much easier-to-use datastructure out of this tensor - a vector of 2D matrices (OpenCV does not do tensors well)
+        // Create a much easier-to-use datastructure out of this tensor - a vector of 2D matrices (OpenCV does not do tensors well).
+        // We don't resize these up front: the parser works in upsampled coordinates, but it only reads the upsampled values
+        // around candidate peaks and along candidate limbs, so each map computes those on demand.
         const int ksizes2d[] = {in_keys.size[2], in_keys.size[3]};
-        std::vector<cv::Mat> heatmaps(in_keys.size[1]);
-        for (size_t i = 0; i < heatmaps.size(); i++)
+        std::vector<pose::UpsampledMap> heatmaps;
+        heatmaps.reserve(in_keys.size[1]);
+        for (int i = 0; i < in_keys.size[1]; i++)
         {
             // Pull out the next heatmap
             cv::Range indices[] = { cv::Range(i, i + 1), cv::Range::all(), cv::Range::all() };
             auto tmp = cv::Mat(reshaped_heatmaps(indices));
 
             // Remove its first dimension, so now it is a 2D Mat
-            heatmaps[i] = cv::Mat(2, ksizes2d, in_keys.type(), reinterpret_cast<void *>(tmp.ptr<float>(0)));
-
-            // I don't know about this:
-            cv::resize(heatmaps[i], heatmaps[i], cv::Size(), upsample_ratio, upsample_ratio, cv::INTER_CUBIC);
+            heatmaps.emplace_back(cv::Mat(2, ksizes2d, in_keys.type(), reinterpret_cast<void *>(tmp.ptr<float>(0))), upsample_ratio);
         }
 
         // Do the same for the PAFs
         const int psizes2d[] = {in_pafs.size[2], in_pafs.size[3]};
-        std::vector<cv::Mat> pafs(in_pafs.size[1]);
-        for (size_t i = 0; i < pafs.size(); i++)
+        std::vector<pose::UpsampledMap> pafs;
+        pafs.reserve(in_pafs.size[1]);
+        for (int i = 0; i < in_pafs.size[1]; i++)
         {
             // Pull out the next PAF
             cv::Range indices[] = { cv::Range(i, i + 1), cv::Range::all(), cv::Range::all() };
             auto tmp = cv::Mat(reshaped_pafs(indices));
 
             // Remove its first dimension, so now it is a 2D Mat
-            pafs[i] = cv::Mat(2, psizes2d, in_pafs.type(), reinterpret_cast<void *>(tmp.ptr<float>(0)));
-
-            // I don't know about this:
-            cv::resize(pafs[i], pafs[i], cv::Size(), upsample_ratio, upsample_ratio, cv::INTER_CUBIC);
+            pafs.emplace_back(cv::Mat(2, psizes2d, in_pafs.type(), reinterpret_cast<void *>(tmp.ptr<float>(0))), upsample_ratio);
         }
 
         // Now extract all the poses out of the data
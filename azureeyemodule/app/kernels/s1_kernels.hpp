@@ -11,6 +11,11 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/gapi/streaming/desync.hpp>
 
+// Local includes
+#include "nms.hpp"
+#include "tensor.hpp"
+#include "tuning.hpp"
+
 namespace cv {
 namespace gapi {
 namespace streaming {
@@ -26,6 +31,37 @@ G_API_OP(GParseS1WithConf, <GDetectionsWithConf(GMat, GMat, GOpaque<Size>, float
     }
 };
 
+namespace {
+    /** A (proposal, class) pair that passed the confidence threshold. Its box is not decoded until it survives selection. */
+    struct S1Candidate {
+        float conf;
+        int   proposal;
+        int   label;
+    };
+
+    /** Heap order that keeps the least confident candidate at the front. */
+    inline bool s1_less_confident_first(const S1Candidate& a, const S1Candidate& b)
+    {
+        return a.conf > b.conf;
+    }
+
+    /** Offers the candidate to a heap that holds at most `k` candidates, evicting the least confident one if need be. */
+    inline void s1_offer(std::vector<S1Candidate>& heap, size_t k, const S1Candidate& candidate)
+    {
+        if (heap.size() < k)
+        {
+            heap.push_back(candidate);
+            std::push_heap(heap.begin(), heap.end(), s1_less_confident_first);
+        }
+        else if (candidate.conf > heap.front().conf)
+        {
+            std::pop_heap(heap.begin(), heap.end(), s1_less_confident_first);
+            heap.back() = candidate;
+            std::push_heap(heap.begin(), heap.end(), s1_less_confident_first);
+        }
+    }
+} // anonymous namespace
+
 /** Kernel implementation of S1 op */
 GAPI_OCV_KERNEL(GOCVParseS1WithConf, GParseS1WithConf)
 {
@@ -48,37 +84,63 @@ GAPI_OCV_KERNEL(GOCVParseS1WithConf, GParseS1WithConf)
         const int NUM_CLASSES = in_probs_dims[3];
         const int OBJECT_SIZE = in_boxes_dims[3];
 
-        out_boxes.clear();
-        out_labels.clear();
-        out_confidences.clear();
+        // Scratch space, kept across frames so that we don't reallocate it on every inference.
+        static thread_local std::vector<std::vector<S1Candidate>> heaps;
+        static thread_local std::vector<nms::Detection> detections;
 
-        struct Detection {
-            cv::Rect rect;
-            float    conf;
-            int      label;
-        };
-        std::vector<Detection> detections;
+        GAPI_Assert(tensor::is_supported_depth(in_raw_boxes.depth()));
+        GAPI_Assert(tensor::is_supported_depth(in_raw_probs.depth()));
+        confidence_threshold = tuning::get(tuning::Param::CONFIDENCE_THRESHOLD, confidence_threshold);
+        nms_threshold = tuning::get(tuning::Param::NMS_THRESHOLD, nms_threshold);
 
-        const auto boxes = in_raw_boxes.ptr<float>();
-        const auto probs = in_raw_probs.ptr<float>();
+        nms::Params params;
+        params.iou_threshold = nms_threshold;
+
+        // Every probability gets read, so those are widened up front if they need to be. Only a few boxes get read,
+        // so lower precision boxes are widened one at a time below.
+        static thread_local std::vector<float> widened_probs;
+        const float *probs = tensor::as_float(in_raw_probs, widened_probs);
+        const float *boxes = (in_raw_boxes.depth() == CV_32F) ? in_raw_boxes.ptr<float>() : nullptr;
+
+        // Select the top K candidates of each class (class 0 is the background).
+        const size_t top_k = (params.top_k > 0) ? params.top_k : static_cast<size_t>(MAX_PROPOSALS);
+        heaps.resize(std::max(NUM_CLASSES - 1, 0));
+        for (auto& heap : heaps)
+        {
+            heap.clear();
+        }
 
         for (int i = 0; i < MAX_PROPOSALS; i++)
         {
+            const float *proposal_probs = probs + i * NUM_CLASSES;
             for (int label = 1; label < NUM_CLASSES; label++)
             {
-                float confidence = probs[i * NUM_CLASSES + label];
-
-                if (confidence < confidence_threshold)
+                if (proposal_probs[label] < confidence_threshold)
                 {
                     continue; // skip objects with low confidence
                 }
 
-                float center_x = boxes[i * OBJECT_SIZE];
-                float center_y = boxes[i * OBJECT_SIZE + 1];
-                float w = boxes[i * OBJECT_SIZE + 2];
-                float h = boxes[i * OBJECT_SIZE + 3];
+                s1_offer(heaps[label - 1], top_k, S1Candidate{ proposal_probs[label], i, label - 1 });
+            }
+        }
+
+        // Only now decode the boxes, and only for the candidates that survived selection.
+        detections.clear();
+        for (const auto& heap : heaps)
+        {
+            for (const auto& c : heap)
+            {
+                float box[4];
+                for (int k = 0; k < 4; k++)
+                {
+                    const size_t offset = static_cast<size_t>(c.proposal) * OBJECT_SIZE + k;
+                    box[k] = (boxes != nullptr) ? boxes[offset] : tensor::at(in_raw_boxes, offset);
+                }
 
-                const Rect surface({ 0,0 }, in_size);
+                float center_x = box[0];
+                float center_y = box[1];
+                float w = box[2];
+                float h = box[3];
 
                 Rect rc;  // map relative coordinates to the original image scale
                 rc.x = static_cast<int>((center_x - w / 2) * in_size.width);
@@ -86,43 +148,23 @@ GAPI_OCV_KERNEL(GOCVParseS1WithConf, GParseS1WithConf)
                 rc.width = static_cast<int>(w * in_size.width);
                 rc.height = static_cast<int>(h * in_size.height);
 
-                detections.emplace_back(Detection{ rc, confidence, label - 1 });
+                detections.emplace_back(nms::Detection{ rc, c.conf, c.label });
             }
         }
 
-        std::stable_sort(std::begin(detections), std::end(detections),
-            [](const Detection& a, const Detection& b) {
-                return a.conf > b.conf;
-            });
+        nms::suppress(detections, params);
 
-        if (nms_threshold < 1.0f)
-        {
-            for (const auto& d : detections)
-            {
-                // Reject boxes which overlap with previously pushed ones
-                // (They are sorted by confidence, so rejected box
-                // always has a smaller confidence
-                if (std::end(out_boxes) ==
-                    std::find_if(std::begin(out_boxes), std::end(out_boxes),
-                        [&d, nms_threshold](const Rect& r) {
-                            float rectOverlap = 1.f - static_cast<float>(jaccardDistance(r, d.rect));
-                            return rectOverlap > nms_threshold;
-                        }))
-                {
-                    out_boxes.emplace_back(d.rect);
-                    out_labels.emplace_back(d.label);
-                    out_confidences.emplace_back(d.conf);
-                }
-            }
-        }
-        else
+        out_boxes.clear();
+        out_labels.clear();
+        out_confidences.clear();
+        out_boxes.reserve(detections.size());
+        out_labels.reserve(detections.size());
+        out_confidences.reserve(detections.size());
+        for (const auto& d : detections)
         {
-            for (const auto& d : detections)
-            {
-                out_boxes.emplace_back(d.rect);
-                out_labels.emplace_back(d.label);
-                out_confidences.emplace_back(d.conf);
-            }
+            out_boxes.emplace_back(d.rect);
+            out_labels.emplace_back(d.label);
+            out_confidences.emplace_back(d.conf);
         }
     }
 };
@@ -11,6 +11,12 @@ GDetectionsWithConf parseSSDWithConf(const GMat& in, const GOpaque<Size> &in_sz,
     return GParseSSDWithConf::on(in, in_sz, confidence_threshold, filter_label);
 }
 
+GDetectionsWithConf parseONNXSSDWithConf(const GMat &num_detections, const GMat &boxes, const GMat &scores, const GMat &classes, const GOpaque<Size> &in_sz,
+                                         float confidence_threshold, int filter_label)
+{
+    return GParseONNXSSDWithConf::on(num_detections, boxes, scores, classes, in_sz, confidence_threshold, filter_label);
+}
+
 } // namespace streaming
 } // namespace gapi
 } // namespace cv
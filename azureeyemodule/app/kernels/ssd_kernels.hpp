@@ -3,6 +3,7 @@
 #pragma once
 
 // Standard libary includes
+#include <algorithm>
 #include <tuple>
 #include <vector>
 
@@ -10,6 +11,11 @@
 #include <opencv2/gapi/mx.hpp>
 #include <opencv2/gapi/cpu/gcpukernel.hpp>
 
+// Local includes
+#include "ssd_parser.hpp"
+#include "tensor.hpp"
+#include "tuning.hpp"
+
 
 namespace cv {
 namespace gapi {
@@ -40,58 +46,75 @@ GAPI_OCV_KERNEL(GOCVParseSSDWithConf, GParseSSDWithConf)
         const auto& in_ssd_dims = in_ssd_result.size;
         GAPI_Assert(in_ssd_dims.dims() == 4u);
 
-        const int MAX_PROPOSALS = in_ssd_dims[2];
-        const int OBJECT_SIZE = in_ssd_dims[3];
-        GAPI_Assert(OBJECT_SIZE == 7); // fixed SSD object size
+        GAPI_Assert(tensor::is_supported_depth(in_ssd_result.depth()));
+        confidence_threshold = tuning::get(tuning::Param::CONFIDENCE_THRESHOLD, confidence_threshold);
 
-        out_boxes.clear();
-        out_labels.clear();
-        out_confidences.clear();
+        int MAX_PROPOSALS = in_ssd_dims[2];
+        const int OBJECT_SIZE = in_ssd_dims[3];
+        GAPI_Assert(OBJECT_SIZE == ssd::OBJECT_SIZE); // fixed SSD object size
 
-        const auto items = in_ssd_result.ptr<float>();
-        for (int i = 0; i < MAX_PROPOSALS; i++)
+        // Lower precision outputs only get widened up to the end-of-detections marker.
+        const float *items = in_ssd_result.ptr<float>();
+        if (in_ssd_result.depth() != CV_32F)
         {
-            const auto it = items + i * OBJECT_SIZE;
-            float image_id = it[0];
-            float label = it[1];
-            float confidence = it[2];
-            float rc_left = it[3];
-            float rc_top = it[4];
-            float rc_right = it[5];
-            float rc_bottom = it[6];
-
-            if (image_id < 0.f)
-            {
-                break;    // marks end-of-detections
-            }
-
-            if (confidence < confidence_threshold)
-            {
-                continue; // skip objects with low confidence
-            }
-
-            if (filter_label != -1 && static_cast<int>(label) != filter_label)
-            {
-                continue; // filter out object classes if filter is specified
-            }
-
-            const Rect surface({ 0,0 }, in_size);
-
-            Rect rc;  // map relative coordinates to the original image scale
-            rc.x = static_cast<int>(rc_left * in_size.width);
-            rc.y = static_cast<int>(rc_top * in_size.height);
-            rc.width = static_cast<int>(rc_right * in_size.width) - rc.x;
-            rc.height = static_cast<int>(rc_bottom * in_size.height) - rc.y;
-            out_boxes.emplace_back(rc & surface);
-            out_labels.emplace_back(label);
-            out_confidences.emplace_back(confidence);
+            static thread_local std::vector<float> widened;
+            MAX_PROPOSALS = ssd::widen_proposals(in_ssd_result, MAX_PROPOSALS, widened);
+            items = widened.data();
         }
+
+        ssd::DetectionBuffer out(out_boxes, out_labels, out_confidences);
+        ssd::parse_ssd(items, MAX_PROPOSALS, in_size, confidence_threshold, filter_label, out);
+    }
+};
+
+/** Op for parsing the four outputs (num_detections, detection_boxes, detection_scores, detection_classes) of an ONNX SSD network */
+G_API_OP(GParseONNXSSDWithConf, <GDetectionsWithConf(GMat, GMat, GMat, GMat, GOpaque<Size>, float, int)>, "org.opencv.dnn.parseONNXSSDWithConf")
+{
+    static std::tuple<GArrayDesc, GArrayDesc, GArrayDesc> outMeta(const GMatDesc&, const GMatDesc&, const GMatDesc&, const GMatDesc&, const GOpaqueDesc&, float, int)
+    {
+        return std::make_tuple(empty_array_desc(), empty_array_desc(), empty_array_desc());
+    }
+};
+
+/** Kernel implementation of the ONNX SSD parsing */
+GAPI_OCV_KERNEL(GOCVParseONNXSSDWithConf, GParseONNXSSDWithConf)
+{
+    static void run(const Mat & in_num_detections,
+        const Mat & in_boxes,
+        const Mat & in_scores,
+        const Mat & in_classes,
+        const Size & in_size,
+        float confidence_threshold,
+        int filter_label,
+        std::vector<Rect> & out_boxes,
+        std::vector<int> & out_labels,
+        std::vector<float> & out_confidences) {
+        GAPI_Assert(in_num_detections.depth() == CV_32F);
+        GAPI_Assert(in_boxes.depth() == CV_32F);
+        GAPI_Assert(in_scores.depth() == CV_32F);
+        GAPI_Assert(in_classes.depth() == CV_32F);
+        GAPI_Assert(in_boxes.isContinuous() && in_scores.isContinuous() && in_classes.isContinuous());
+
+        GAPI_Assert(in_num_detections.total() >= 1);
+        const int max_detections = static_cast<int>(in_scores.total());
+        GAPI_Assert(in_boxes.total() == 4 * in_scores.total());
+        GAPI_Assert(in_classes.total() == in_scores.total());
+
+        confidence_threshold = tuning::get(tuning::Param::CONFIDENCE_THRESHOLD, confidence_threshold);
+        const int n_detections = std::min(std::max(static_cast<int>(in_num_detections.ptr<float>()[0]), 0), max_detections);
+
+        ssd::DetectionBuffer out(out_boxes, out_labels, out_confidences);
+        ssd::parse_onnx_ssd(in_boxes.ptr<float>(), in_scores.ptr<float>(), in_classes.ptr<float>(), n_detections, in_size, confidence_threshold, filter_label, out);
     }
 };
 
 /** C++ wrapper function for parsing SSD. */
 GAPI_EXPORTS GDetectionsWithConf parseSSDWithConf(const GMat &in, const GOpaque<Size>& in_sz, float confidence_threshold = 0.5f, int filter_label = -1);
 
+/** C++ wrapper function for parsing the outputs of an ONNX SSD. */
+GAPI_EXPORTS GDetectionsWithConf parseONNXSSDWithConf(const GMat &num_detections, const GMat &boxes, const GMat &scores, const GMat &classes, const GOpaque<Size>& in_sz,
+                                                      float confidence_threshold = 0.5f, int filter_label = -1);
+
 } // namespace streaming
 } // namespace gapi
 } // namespace cv
@@ -0,0 +1,235 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// Standard libary includes
+#include <algorithm>
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+// Local includes
+#include "ssd_parser.hpp"
+#include "tensor.hpp"
+
+namespace ssd {
+
+DetectionBuffer::DetectionBuffer(std::vector<cv::Rect> &boxes, std::vector<int> &labels, std::vector<float> &confidences)
+    : boxes(boxes), labels(labels), confidences(confidences)
+{
+}
+
+void DetectionBuffer::reset(size_t capacity)
+{
+    this->boxes.clear();
+    this->labels.clear();
+    this->confidences.clear();
+
+    this->boxes.reserve(capacity);
+    this->labels.reserve(capacity);
+    this->confidences.reserve(capacity);
+}
+
+void DetectionBuffer::push(const cv::Rect &box, int label, float confidence)
+{
+    this->boxes.push_back(box);
+    this->labels.push_back(label);
+    this->confidences.push_back(confidence);
+}
+
+size_t DetectionBuffer::size() const
+{
+    return this->boxes.size();
+}
+
+/** Maps the relative coordinates of the given proposal to the image and appends it to the buffer. */
+static inline void emit(const float *it, const cv::Size &in_size, const cv::Rect &surface, DetectionBuffer &out)
+{
+    cv::Rect rc;
+    rc.x = static_cast<int>(it[3] * in_size.width);
+    rc.y = static_cast<int>(it[4] * in_size.height);
+    rc.width = static_cast<int>(it[5] * in_size.width) - rc.x;
+    rc.height = static_cast<int>(it[6] * in_size.height) - rc.y;
+    out.push(rc & surface, static_cast<int>(it[1]), it[2]);
+}
+
+void parse_ssd(const float *items, int n_proposals, const cv::Size &in_size, float confidence_threshold, int filter_label, DetectionBuffer &out)
+{
+    out.reset(static_cast<size_t>(n_proposals));
+
+    const cv::Rect surface({ 0, 0 }, in_size);
+    int i = 0;
+
+#if CV_SIMD
+    // The proposals are rows of 7 floats, so we gather the image ID, label, and confidence columns
+    // of one batch of rows into lane-sized scratch arrays and do all the comparisons at once.
+    constexpr int lanes = cv::v_float32::nlanes;
+    float ids[lanes];
+    float labels[lanes];
+    float confidences[lanes];
+
+    const cv::v_float32 v_zero = cv::vx_setzero_f32();
+    const cv::v_float32 v_threshold = cv::vx_setall_f32(confidence_threshold);
+    const cv::v_int32 v_filter = cv::vx_setall_s32(filter_label);
+
+    for (; i <= n_proposals - lanes; i += lanes)
+    {
+        const float *batch = items + i * OBJECT_SIZE;
+        for (int k = 0; k < lanes; k++)
+        {
+            ids[k] = batch[k * OBJECT_SIZE];
+            labels[k] = batch[k * OBJECT_SIZE + 1];
+            confidences[k] = batch[k * OBJECT_SIZE + 2];
+        }
+
+        const cv::v_float32 v_ids = cv::vx_load(ids);
+        const cv::v_float32 v_confidences = cv::vx_load(confidences);
+
+        int keep = cv::v_signmask((v_confidences >= v_threshold) & (v_ids >= v_zero));
+        if (filter_label != -1)
+        {
+            keep &= cv::v_signmask(cv::v_trunc(cv::vx_load(labels)) == v_filter);
+        }
+
+        // A negative image ID marks the end of the detections. Keep only what comes before it and stop.
+        const int end = cv::v_signmask(v_ids < v_zero);
+        int n_valid = lanes;
+        if (end != 0)
+        {
+            n_valid = 0;
+            while (((end >> n_valid) & 1) == 0)
+            {
+                n_valid++;
+            }
+        }
+
+        for (int k = 0; keep != 0 && k < n_valid; k++)
+        {
+            if (keep & (1 << k))
+            {
+                emit(batch + k * OBJECT_SIZE, in_size, surface, out);
+            }
+        }
+
+        if (end != 0)
+        {
+            return;
+        }
+    }
+#endif
+
+    for (; i < n_proposals; i++)
+    {
+        const float *it = items + i * OBJECT_SIZE;
+
+        if (it[0] < 0.f)
+        {
+            break;    // marks end-of-detections
+        }
+
+        // These are written as negated >= tests so that NaNs get dropped here just as they do in the SIMD loop.
+        if (!(it[0] >= 0.f))
+        {
+            continue; // skip objects with a NaN image ID
+        }
+
+        if (!(it[2] >= confidence_threshold))
+        {
+            continue; // skip objects with low (or NaN) confidence
+        }
+
+        if (filter_label != -1 && static_cast<int>(it[1]) != filter_label)
+        {
+            continue; // filter out object classes if filter is specified
+        }
+
+        emit(it, in_size, surface, out);
+    }
+}
+
+int widen_proposals(const cv::Mat &result, int n_proposals, std::vector<float> &out)
+{
+    constexpr int batch = 16;
+    out.resize(static_cast<size_t>(n_proposals) * OBJECT_SIZE);
+
+    int widened = 0;
+    while (widened < n_proposals)
+    {
+        const int count = std::min(batch, n_proposals - widened);
+        float *first = out.data() + static_cast<size_t>(widened) * OBJECT_SIZE;
+        tensor::widen(result, static_cast<size_t>(widened) * OBJECT_SIZE, static_cast<size_t>(count) * OBJECT_SIZE, first);
+        widened += count;
+
+        for (int k = 0; k < count; k++)
+        {
+            if (first[k * OBJECT_SIZE] < 0.f)
+            {
+                return widened;
+            }
+        }
+    }
+
+    return widened;
+}
+
+/** Maps the given relative [top, left, bottom, right] box to the image and appends it to the buffer. */
+static inline void emit_onnx(const float *box, float label, float confidence, const cv::Size &in_size, const cv::Rect &surface, DetectionBuffer &out)
+{
+    cv::Rect rc;
+    rc.x = static_cast<int>(box[1] * in_size.width);
+    rc.y = static_cast<int>(box[0] * in_size.height);
+    rc.width = static_cast<int>(box[3] * in_size.width) - rc.x;
+    rc.height = static_cast<int>(box[2] * in_size.height) - rc.y;
+    out.push(rc & surface, static_cast<int>(label), confidence);
+}
+
+void parse_onnx_ssd(const float *boxes, const float *scores, const float *classes, int n_detections, const cv::Size &in_size, float confidence_threshold, int filter_label, DetectionBuffer &out)
+{
+    out.reset(static_cast<size_t>(n_detections));
+
+    const cv::Rect surface({ 0, 0 }, in_size);
+    int i = 0;
+
+#if CV_SIMD
+    // Unlike the OpenVINO layout, scores and classes each have their own contiguous array, so we can load them straight in.
+    constexpr int lanes = cv::v_float32::nlanes;
+    const cv::v_float32 v_threshold = cv::vx_setall_f32(confidence_threshold);
+    const cv::v_int32 v_filter = cv::vx_setall_s32(filter_label);
+
+    for (; i <= n_detections - lanes; i += lanes)
+    {
+        int keep = cv::v_signmask(cv::vx_load(scores + i) >= v_threshold);
+        if (filter_label != -1)
+        {
+            keep &= cv::v_signmask(cv::v_trunc(cv::vx_load(classes + i)) == v_filter);
+        }
+
+        for (int k = 0; keep != 0 && k < lanes; k++)
+        {
+            if (keep & (1 << k))
+            {
+                emit_onnx(boxes + 4 * (i + k), classes[i + k], scores[i + k], in_size, surface, out);
+            }
+        }
+    }
+#endif
+
+    for (; i < n_detections; i++)
+    {
+        // Negated so that NaN scores get dropped here just as they do in the SIMD loop.
+        if (!(scores[i] >= confidence_threshold))
+        {
+            continue; // skip objects with low (or NaN) confidence
+        }
+
+        if (filter_label != -1 && static_cast<int>(classes[i]) != filter_label)
+        {
+            continue; // filter out object classes if filter is specified
+        }
+
+        emit_onnx(boxes + 4 * i, classes[i], scores[i], in_size, surface, out);
+    }
+}
+
+} // namespace ssd
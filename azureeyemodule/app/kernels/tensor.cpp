@@ -0,0 +1,79 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// Standard libary includes
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+
+// Local includes
+#include "tensor.hpp"
+
+namespace tensor {
+
+bool is_supported_depth(int depth)
+{
+    return (depth == CV_32F) || (depth == CV_16F) || (depth == CV_8U);
+}
+
+float at(const cv::Mat &in, size_t i)
+{
+    switch (in.depth())
+    {
+        case CV_32F:
+            return in.ptr<float>()[i];
+        case CV_16F:
+            return static_cast<float>(in.ptr<cv::float16_t>()[i]);
+        case CV_8U:
+            return static_cast<float>(in.ptr<uchar>()[i]);
+        default:
+            CV_Error(cv::Error::StsUnsupportedFormat, "Network outputs must be FP32, FP16, or U8");
+    }
+}
+
+void widen(const cv::Mat &in, size_t offset, size_t count, float *out)
+{
+    CV_Assert(is_supported_depth(in.depth()));
+    CV_Assert(in.isContinuous());
+    CV_Assert(offset + count <= in.total());
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Wrap the range and the destination in headers, so that convertTo (which is vectorized for all of these depths)
+    // writes straight into `out` instead of allocating.
+    const cv::Mat src(1, static_cast<int>(count), in.depth(), const_cast<uchar *>(in.ptr()) + offset * in.elemSize1());
+    cv::Mat dst(1, static_cast<int>(count), CV_32F, out);
+    src.convertTo(dst, CV_32F);
+}
+
+const float *as_float(const cv::Mat &in, std::vector<float> &scratch)
+{
+    CV_Assert(in.isContinuous());
+
+    if (in.depth() == CV_32F)
+    {
+        return in.ptr<float>();
+    }
+
+    scratch.resize(in.total());
+    widen(in, 0, in.total(), scratch.data());
+    return scratch.data();
+}
+
+const cv::Mat &as_float(const cv::Mat &in, cv::Mat &scratch)
+{
+    if (in.depth() == CV_32F)
+    {
+        return in;
+    }
+
+    CV_Assert(is_supported_depth(in.depth()));
+    in.convertTo(scratch, CV_32F);
+    return scratch;
+}
+
+} // namespace tensor
@@ -0,0 +1,36 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+
+// Standard libary includes
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+
+namespace tensor {
+
+/**
+ * Network outputs can come to us as FP32, FP16, or U8, depending on the output precision that the blob was compiled with.
+ * The parsers all work in floats, so these helpers let them read any of those depths, widening only the elements they need.
+ */
+
+/** Returns true if we know how to read a tensor of the given depth. */
+bool is_supported_depth(int depth);
+
+/** Returns element `i` of the (continuous) tensor `in` as a float. Meant for sparse reads. */
+float at(const cv::Mat &in, size_t i);
+
+/** Widens `count` elements of the (continuous) tensor `in`, starting at element `offset`, into `out`. */
+void widen(const cv::Mat &in, size_t offset, size_t count, float *out);
+
+/**
+ * Returns a pointer to all of the (continuous) tensor `in` as floats. If `in` is already FP32, this points into `in` and nothing
+ * is copied. Otherwise the whole tensor is widened into `scratch` and this points into that.
+ */
+const float *as_float(const cv::Mat &in, std::vector<float> &scratch);
+
+/** Returns `in` itself if it is already FP32, and otherwise widens it into `scratch` (same shape, FP32) and returns that. */
+const cv::Mat &as_float(const cv::Mat &in, cv::Mat &scratch);
+
+} // namespace tensor
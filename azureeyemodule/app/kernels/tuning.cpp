@@ -0,0 +1,70 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// Standard libary includes
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <string>
+
+// Local includes
+#include "tuning.hpp"
+
+namespace tuning {
+
+/** Number of parameters in the Param enum. */
+static constexpr int N_PARAMS = static_cast<int>(Param::OCR_SEGMENTATION_THRESHOLD) + 1;
+
+/** Stands in for "no live value", so the kernels use their graph's value. */
+static constexpr float UNSET = std::numeric_limits<float>::quiet_NaN();
+
+/** The live values. Written by the module twin thread and read by the kernels, so each one is a single atomic. */
+static std::atomic<float> live_values[N_PARAMS] = { {UNSET}, {UNSET}, {UNSET}, {UNSET} };
+
+float get(Param param, float graph_value)
+{
+    const float value = live_values[static_cast<int>(param)].load(std::memory_order_relaxed);
+    return std::isnan(value) ? graph_value : value;
+}
+
+bool set(Param param, float value)
+{
+    // The NMS kernels require a strictly positive IoU threshold, so we must never hand them a zero.
+    const bool zero_allowed = (param != Param::NMS_THRESHOLD);
+    if (!((zero_allowed ? value >= 0.0f : value > 0.0f) && value <= 1.0f))
+    {
+        return false;
+    }
+
+    live_values[static_cast<int>(param)].store(value, std::memory_order_relaxed);
+    return true;
+}
+
+void clear(Param param)
+{
+    live_values[static_cast<int>(param)].store(UNSET, std::memory_order_relaxed);
+}
+
+std::string valid_range(Param param)
+{
+    return (param == Param::NMS_THRESHOLD) ? "(0, 1]" : "[0, 1]";
+}
+
+std::string to_string(Param param)
+{
+    switch (param)
+    {
+        case Param::CONFIDENCE_THRESHOLD:
+            return "ConfidenceThreshold";
+        case Param::NMS_THRESHOLD:
+            return "NMSThreshold";
+        case Param::OCR_LINK_THRESHOLD:
+            return "OCRLinkThreshold";
+        case Param::OCR_SEGMENTATION_THRESHOLD:
+            return "OCRSegmentationThreshold";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+} // namespace tuning
@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+
+// Standard libary includes
+#include <string>
+
+namespace tuning {
+
+/**
+ * Post-processing parameters that can be changed while the pipeline is running.
+ *
+ * Every graph still passes its own values for these to its parser ops. Those are the defaults. If a live value
+ * has been set (through the module twin), the kernels use it instead, starting with the next frame they parse,
+ * so re-tuning a threshold does not require recompiling (and so restarting) the pipeline.
+ */
+enum class Param {
+    /** Detections (or classes, or mask pixels) with a confidence below this are dropped. */
+    CONFIDENCE_THRESHOLD,
+
+    /** Non-maximum suppression IoU threshold. Unlike the others, zero is not allowed. */
+    NMS_THRESHOLD,
+
+    /** OCR text detection: pixel link threshold. */
+    OCR_LINK_THRESHOLD,
+
+    /** OCR text detection: text/no-text segmentation threshold. */
+    OCR_SEGMENTATION_THRESHOLD
+};
+
+/**
+ * Returns the live value of the given parameter if one has been set, and `graph_value` otherwise.
+ * This is lock-free, so kernels can call it on every frame.
+ */
+float get(Param param, float graph_value);
+
+/** Sets the live value of the given parameter. Returns false (and changes nothing) if the value is not in `valid_range(param)`. */
+bool set(Param param, float value);
+
+/** Forgets the live value of the given parameter, so that the kernels go back to the values their graphs were compiled with. */
+void clear(Param param);
+
+/** Returns the values the given parameter can take, as a string for error messages, such as "[0, 1]". */
+std::string valid_range(Param param);
+
+/** Returns a string representation of the given parameter. */
+std::string to_string(Param param);
+
+} // namespace tuning
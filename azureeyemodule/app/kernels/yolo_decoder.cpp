@@ -0,0 +1,250 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// Standard libary includes
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+// Local includes
+#include "tensor.hpp"
+#include "yolo_decoder.hpp"
+
+namespace yolo {
+
+size_t Config::n_heads() const
+{
+    return this->masks.empty() ? 1 : this->masks.size();
+}
+
+std::vector<int> Config::head_anchors(size_t head) const
+{
+    if (this->masks.empty())
+    {
+        std::vector<int> all(this->anchors.size() / 2);
+        for (size_t i = 0; i < all.size(); i++)
+        {
+            all[i] = static_cast<int>(i);
+        }
+        return all;
+    }
+
+    return this->masks.at(head);
+}
+
+bool Config::is_valid() const
+{
+    if (this->anchors.empty() || (this->anchors.size() % 2 != 0) || (this->coords <= 0))
+    {
+        return false;
+    }
+
+    const int n_anchors = static_cast<int>(this->anchors.size() / 2);
+    for (const auto &mask : this->masks)
+    {
+        if (mask.empty())
+        {
+            return false;
+        }
+
+        for (auto idx : mask)
+        {
+            if ((idx < 0) || (idx >= n_anchors))
+            {
+                return false;
+            }
+        }
+    }
+
+    return this->sides.empty() || (this->sides.size() == this->n_heads());
+}
+
+/** Logistic function in single precision. */
+static inline float sigmoid(float x)
+{
+    return 1.0f / (1.0f + std::exp(-x));
+}
+
+/**
+ * Returns the value that a raw score has to reach for its activation to reach `threshold`.
+ * This lets us threshold the raw planes without evaluating any exponentials.
+ */
+static inline float activation_threshold(float threshold, bool apply_sigmoid)
+{
+    if (!apply_sigmoid)
+    {
+        return threshold;
+    }
+
+    const float t = std::min(std::max(threshold, 1e-6f), 1.0f - 1e-6f);
+    return std::log(t / (1.0f - t));
+}
+
+/** Works out the grid side of a head from the config or from the shape of its tensor. */
+static int infer_side(const cv::Mat &head, size_t head_index, const Config &config)
+{
+    if ((head_index < config.sides.size()) && (config.sides[head_index] > 0))
+    {
+        return config.sides[head_index];
+    }
+
+    const auto &dims = head.size;
+    if (dims.dims() == 4)
+    {
+        if ((dims[2] > 1) && (dims[2] == dims[3]))
+        {
+            return dims[2]; // {1, A * (C + 5), S, S}
+        }
+        else if ((dims[1] > 1) && (dims[1] == dims[2]))
+        {
+            return dims[1]; // {1, S, S, A * (C + 5)}
+        }
+    }
+
+    // Flat tensors don't tell us. Assume the usual 13, 26, 52... progression.
+    return 13 << head_index;
+}
+
+/** Per-anchor decoding parameters for one head. */
+struct AnchorEntry
+{
+    /** The anchor's width, relative to the image. */
+    float width;
+
+    /** The anchor's height, relative to the image. */
+    float height;
+
+    /** The offset of the anchor's first plane in the head. */
+    size_t base;
+};
+
+void decode_head(const cv::Mat &head, size_t head_index, const Config &config, const cv::Size &in_size, float confidence_threshold, std::vector<nms::Detection> &detections)
+{
+    CV_Assert(tensor::is_supported_depth(head.depth()));
+    CV_Assert(head.isContinuous());
+    CV_Assert(head_index < config.n_heads());
+
+    const std::vector<int> mask = config.head_anchors(head_index);
+    const int n_anchors = static_cast<int>(mask.size());
+    const int side = infer_side(head, head_index, config);
+    const int side_square = side * side;
+    const size_t total = head.total();
+
+    CV_Assert(total % (static_cast<size_t>(n_anchors) * side_square) == 0);
+    const int entries = static_cast<int>(total / (static_cast<size_t>(n_anchors) * side_square));
+    const int n_classes = entries - config.coords - 1;
+    CV_Assert(n_classes > 0);
+
+    // Build the per-anchor table once, so that the inner loops only do pointer arithmetic.
+    const float anchor_scale = (config.input_size > 0) ? static_cast<float>(config.input_size) : static_cast<float>(side);
+    std::vector<AnchorEntry> table(n_anchors);
+    for (int b = 0; b < n_anchors; b++)
+    {
+        table[b].width = config.anchors[2 * mask[b]] / anchor_scale;
+        table[b].height = config.anchors[2 * mask[b] + 1] / anchor_scale;
+        table[b].base = static_cast<size_t>(b) * entries * side_square;
+    }
+
+    const float objectness_threshold = activation_threshold(confidence_threshold, config.sigmoid);
+
+    // FP32 heads are read in place. Lower precision heads have their objectness planes widened (as those are read in full),
+    // and everything else read one element at a time, as only the cells that pass the threshold get read at all.
+    const float *output = (head.depth() == CV_32F) ? head.ptr<float>() : nullptr;
+    static thread_local std::vector<float> widened_objectness;
+    auto read = [&](size_t offset)
+    {
+        return (output != nullptr) ? output[offset] : tensor::at(head, offset);
+    };
+
+    // Decodes the cell at index i of the given anchor, which has already passed the objectness threshold.
+    auto decode_cell = [&](const AnchorEntry &anchor, int i)
+    {
+        const size_t base = anchor.base;
+        const float raw_scale = read(base + config.coords * side_square + i);
+        const float scale = config.sigmoid ? sigmoid(raw_scale) : raw_scale;
+
+        bool have_box = false;
+        cv::Rect box;
+        for (int label = 0; label < n_classes; label++)
+        {
+            const float raw_class = read(base + (config.coords + 1 + label) * side_square + i);
+            const float prob = scale * (config.sigmoid ? sigmoid(raw_class) : raw_class);
+            if (prob < confidence_threshold)
+            {
+                continue;
+            }
+
+            if (!have_box)
+            {
+                // Only pay for the box geometry once some class has survived.
+                float tx = read(base + i);
+                float ty = read(base + side_square + i);
+                if (config.sigmoid)
+                {
+                    tx = sigmoid(tx);
+                    ty = sigmoid(ty);
+                }
+
+                const float x = ((i % side) + tx) / side;
+                const float y = ((i / side) + ty) / side;
+                const float w = std::exp(read(base + 2 * side_square + i)) * anchor.width;
+                const float h = std::exp(read(base + 3 * side_square + i)) * anchor.height;
+
+                box.x = static_cast<int>((x - w / 2) * in_size.width);
+                box.y = static_cast<int>((y - h / 2) * in_size.height);
+                box.width = static_cast<int>(w * in_size.width);
+                box.height = static_cast<int>(h * in_size.height);
+                have_box = true;
+            }
+
+            detections.push_back(nms::Detection{ box, prob, label });
+        }
+    };
+
+    for (const auto &anchor : table)
+    {
+        const size_t objectness_offset = anchor.base + config.coords * side_square;
+        const float *objectness = nullptr;
+        if (output != nullptr)
+        {
+            objectness = output + objectness_offset;
+        }
+        else
+        {
+            widened_objectness.resize(side_square);
+            tensor::widen(head, objectness_offset, side_square, widened_objectness.data());
+            objectness = widened_objectness.data();
+        }
+        int i = 0;
+
+#if CV_SIMD
+        constexpr int lanes = cv::v_float32::nlanes;
+        const cv::v_float32 v_threshold = cv::vx_setall_f32(objectness_threshold);
+        for (; i <= side_square - lanes; i += lanes)
+        {
+            const int passed = cv::v_signmask(cv::vx_load(objectness + i) >= v_threshold);
+            for (int k = 0; passed != 0 && k < lanes; k++)
+            {
+                if (passed & (1 << k))
+                {
+                    decode_cell(anchor, i + k);
+                }
+            }
+        }
+#endif
+
+        for (; i < side_square; i++)
+        {
+            if (objectness[i] >= objectness_threshold)
+            {
+                decode_cell(anchor, i);
+            }
+        }
+    }
+}
+
+} // namespace yolo
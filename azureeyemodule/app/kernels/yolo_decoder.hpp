@@ -0,0 +1,70 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+
+// Standard libary includes
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+
+// Local includes
+#include "nms.hpp"
+
+namespace yolo {
+
+/**
+ * Everything the decoder needs to know about the output heads of a YOLO network.
+ *
+ * The defaults describe the single-head, 13x13, five anchor YOLOv2 network that we have always supported.
+ * Multi-scale networks (YOLOv3/v4-tiny and the like) have one head per grid size and use `masks` to say
+ * which of the anchors belong to which head.
+ */
+struct Config
+{
+    /** Anchor (width, height) pairs, flattened. */
+    std::vector<float> anchors { 0.57273f, 0.677385f, 1.87446f, 2.06253f, 3.33843f, 5.47434f, 7.88282f, 3.52778f, 9.77052f, 9.16828f };
+
+    /** For each head, the indexes of the anchor pairs that it uses. If empty, there is a single head that uses all the anchors. */
+    std::vector<std::vector<int>> masks;
+
+    /** For each head, the side length of its grid. If empty (or zero for a head), we infer it from the head's tensor shape. */
+    std::vector<int> sides;
+
+    /** If positive, the anchors are in pixels of a square network input of this size. Otherwise they are in grid cells. */
+    int input_size = 0;
+
+    /** If true, the heads are raw convolution outputs and we need to apply the logistic function to x, y, objectness, and class scores. */
+    bool sigmoid = false;
+
+    /** Number of coordinates per box. */
+    int coords = 4;
+
+    /** Returns the number of output heads. */
+    size_t n_heads() const;
+
+    /** Returns the anchor indexes that the given head uses. */
+    std::vector<int> head_anchors(size_t head) const;
+
+    /** Returns true if the masks and sides are consistent with the anchors. */
+    bool is_valid() const;
+};
+
+/**
+ * Decodes one output head of a YOLO network into candidate detections, which are appended to `detections`.
+ *
+ * The head is expected to be laid out channel-planar: for each anchor, `coords` box planes, an objectness plane,
+ * then one plane per class, each plane being side * side floats. The objectness plane of each anchor is thresholded
+ * in a single vectorized pass, and box geometry is only decoded for the cells that make it through.
+ *
+ * @param head: The output tensor for this head. Any shape is accepted as long as its total size matches the layout above.
+ *              It may be FP32, FP16, or U8.
+ * @param head_index: The index of this head in the config.
+ * @param config: The network's config.
+ * @param in_size: The size of the image the network ran on. Boxes are scaled to this.
+ * @param confidence_threshold: Candidates whose objectness times class score is below this are dropped.
+ * @param detections: The vector to append the candidates to.
+ */
+void decode_head(const cv::Mat &head, size_t head_index, const Config &config, const cv::Size &in_size, float confidence_threshold, std::vector<nms::Detection> &detections);
+
+} // namespace yolo
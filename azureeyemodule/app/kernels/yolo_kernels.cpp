@@ -17,9 +17,14 @@ namespace gapi {
 namespace streaming {
 
 
-GDetectionsWithConf parseYoloWithConf(const GMat& in, const GOpaque<Size>& in_sz, float confidence_threshold, float nms_threshold, const GYoloAnchors& anchors)
+GDetectionsWithConf parseYoloWithConf(const GMat& in, const GOpaque<Size>& in_sz, float confidence_threshold, float nms_threshold, const yolo::Config& config)
 {
-    return GParseYoloWithConf::on(in, in_sz, confidence_threshold, nms_threshold, anchors);
+    return GParseYoloWithConf::on(in, in_sz, confidence_threshold, nms_threshold, config);
+}
+
+GDetectionsWithConf parseYoloWithConf(const GMat& in_head0, const GMat& in_head1, const GOpaque<Size>& in_sz, float confidence_threshold, float nms_threshold, const yolo::Config& config)
+{
+    return GParseYoloTwoHeadsWithConf::on(in_head0, in_head1, in_sz, confidence_threshold, nms_threshold, config);
 }
 
 } // namespace streaming
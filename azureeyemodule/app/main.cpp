@@ -35,6 +35,7 @@
 #include "secure_ai/secureai.hpp"
 #include "streaming/rtsp.hpp"
 #include "util/helper.hpp"
+#include "util/time_aligned_buffer.hpp"
 
 const std::string keys =
 "{ h help      |        | print this message }"
@@ -42,10 +43,12 @@ const std::string keys =
 "{ h264_out    |        | Output file name for the raw H264 stream. No files written by default }"
 "{ l label     |        | label file }"
 "{ m model     |        | model zip file }"
+"{ op outprec  | FP32   | Output precision for models we convert from .xml or .onnx. Possible values: FP32, FP16, U8 (unet only) }"
 "{ q quit      | false  | If given, we quit on error, rather than loading a default model. Useful for testing }"
 "{ p parser    | ssd100 | Parser kind required for input model. Possible values: ssd100, ssd200, yolo, classification, s1, openpose, onnxssd, faster-rcnn-resnet50, unet, ocr }"
 "{ s size      | native | Output video resolution. Possible values: native, 1080p, 720p }"
 "{ t timealign | false  | Align the RTSP result frames with their corresponding neural network outputs in time }"
+"{ ts tastore  | raw    | How to hold on to frames while they wait for time alignment. Possible values: raw, resized (to the stream resolution), jpeg (resized, then JPEG encoded) }"
 "{ fps         | 10     | Output video frame rate. }"
 "{ i input     |        | Source of input frames. Inbox MIPI camera attached to Eye SoM by default. Possible value: uvc}";
 // video file is not ready in this build yet.
@@ -279,8 +282,10 @@ int main(int argc, char** argv)
     auto str_resolution = cmd.get<std::string>("size");
     auto quit_on_failure = cmd.get<bool>("quit");
     auto timealign = cmd.get<bool>("timealign");
+    auto timealign_storage = cmd.get<std::string>("tastore");
     auto fps = cmd.get<int>("fps");
     auto inputsource = cmd.get<std::string>("input");
+    auto output_precision = cmd.get<std::string>("outprec");
 
     // Sanity check resolution is allowed
     if (!rtsp::is_valid_resolution(str_resolution))
@@ -311,6 +316,21 @@ int main(int argc, char** argv)
         exit(__LINE__);
     }
 
+    // Sanity check the time alignment storage (this can be overridden by Module Twin)
+    if (!timebuf::is_valid_storage(timealign_storage))
+    {
+        util::log_error("Given a time alignment storage that is not allowed: " + timealign_storage);
+        exit(__LINE__);
+    }
+    timebuf::set_storage(timebuf::storage_string_to_enum(timealign_storage));
+
+    // Sanity check the output precision is one we can parse
+    if (!model::AzureEyeModel::set_output_precision(output_precision))
+    {
+        util::log_error("Given an output precision that is not allowed: " + output_precision);
+        exit(__LINE__);
+    }
+
     // Now possibly overwrite some of these parameters based on what we find in modelfiles
     bool loaded = model::AzureEyeModel::load(labelfile, modelfiles, parser_type);
     if (!loaded)
@@ -5,6 +5,7 @@
 #include <fstream>
 #include <parson.h>
 #include <thread>
+#include <tuple>
 
 // Third party includes
 #include <opencv2/highgui.hpp>
@@ -21,6 +22,32 @@
 
 namespace model {
 
+/** The output precision that we convert models to, unless a model's config.json says otherwise. */
+static std::string default_output_precision = "FP32";
+
+/** The output precision for the model that we are loading right now. */
+static std::string output_precision = "FP32";
+
+/** Returns the canonical spelling of the given output precision, or an empty string if we don't support it. */
+static std::string canonical_output_precision(const std::string &precision)
+{
+    const std::string lower = util::to_lower(precision);
+    if (lower == "fp32")
+    {
+        return "FP32";
+    }
+    else if (lower == "fp16")
+    {
+        return "FP16";
+    }
+    else if (lower == "u8")
+    {
+        return "U8";
+    }
+
+    return "";
+}
+
 AzureEyeModel::AzureEyeModel(const std::vector<std::string> &modelfpaths, const std::string &mvcmd, const std::string &videofile, const cv::gapi::mx::Camera::Mode &resolution)
     : modelfiles(modelfpaths), mvcmd(mvcmd), videofile(videofile), resolution(resolution),
       timestamped_frames({cv::Mat(rtsp::DEFAULT_HEIGHT, rtsp::DEFAULT_WIDTH, CV_8UC3, cv::Scalar(0, 0, 0))}),
@@ -129,10 +156,11 @@ void AzureEyeModel::stream_frames(const cv::Mat &raw_frame, const cv::Mat &resul
     {
         // Don't add a status message to the frames that we are keeping back for time alignment,
         // as it could be confusing to someone watching the stream, since the stream will
-        // be delayed by some amount of time.
-        cv::Mat frame_to_mark_up_later;
-        raw_frame.copyTo(frame_to_mark_up_later);
-        this->timestamped_frames.put(std::make_tuple(frame_to_mark_up_later, frame_ts));
+        // be delayed by some amount of time. The buffer keeps its own (possibly compact) copy of the frame.
+        int stream_height;
+        int stream_width;
+        std::tie(stream_height, stream_width) = rtsp::get_height_and_width(rtsp::get_resolution(rtsp::StreamType::RESULT));
+        this->timestamped_frames.put(std::make_tuple(raw_frame, frame_ts), cv::Size(stream_width, stream_height));
 
         // Add status message to the raw frame that we send out right now though.
         rtsp::update_data_raw(new_raw_frame);
@@ -148,6 +176,9 @@ bool AzureEyeModel::load(std::string &labelfile, std::vector<std::string> &model
 {
     std::vector<std::string> resulting_blob_files;
 
+    // A previous model's config.json may have overridden this.
+    output_precision = default_output_precision;
+
     // Loop over all the data items we have in `modelfiles`, converting each one into
     // potentially several .blob files. Each of those .blob files gets pushed into a temporary result vector,
     // which then overwrites the `modelfiles` vector.
@@ -249,13 +280,22 @@ bool AzureEyeModel::convert_model(const std::string &modelfile, std::string &lab
     // Possible solution to be done: before myriad_compile, check if the pipeline is running.
     // May need Intel to provide additional API to check if the pipeline is running.
     const std::string executable = (is_xml == true) ? "/openvino/bin/aarch64/Release/myriad_compile" : "/openvino/bin/aarch64/Release/custom_myriad_compile";
+
+    // U8 outputs are only good for segmentation masks. Everything else needs at least FP16.
+    std::string precision = output_precision;
+    if ((precision == "U8") && (modeltype != parser::Parser::UNET))
+    {
+        util::log_info("U8 output precision is only supported for segmentation models. Using FP16 instead.");
+        precision = "FP16";
+    }
+
     int ret = util::run_command(executable + (" \
                      -m " + modelfile + " \
                      -ip U8 \
                      -VPU_NUMBER_OF_SHAVES 8 \
                      -VPU_NUMBER_OF_CMX_SLICES 8 \
                      -o " + result_location + "\
-                     -op FP32").c_str());
+                     -op " + precision).c_str());
 
     if (ret != 0)
     {
@@ -267,6 +307,19 @@ bool AzureEyeModel::convert_model(const std::string &modelfile, std::string &lab
     return true;
 }
 
+bool AzureEyeModel::set_output_precision(const std::string &precision)
+{
+    const std::string canonical = canonical_output_precision(precision);
+    if (canonical.empty())
+    {
+        return false;
+    }
+
+    default_output_precision = canonical;
+    output_precision = canonical;
+    return true;
+}
+
 void AzureEyeModel::clear_model_storage()
 {
     int ret = util::run_command("rm -rf /app/model && mkdir /app/model");
@@ -398,6 +451,28 @@ bool AzureEyeModel::load_config(const std::string &configfpath, std::vector<std:
         labelfile = "/app/model/" + std::string(json_object_get_string(root_object, "LabelFileName"));
     }
 
+    if (json_object_get_value(root_object, "OutputPrecision") != NULL)
+    {
+        // This is NULL if the value is not a string (a number, say).
+        const char *requested_precision = json_object_get_string(root_object, "OutputPrecision");
+        if (requested_precision == NULL)
+        {
+            util::log_error("Ignoring 'OutputPrecision' in JSON file: it must be a string.");
+        }
+        else
+        {
+            const std::string precision = canonical_output_precision(requested_precision);
+            if (precision.empty())
+            {
+                util::log_error("Ignoring unsupported 'OutputPrecision' in JSON file: " + std::string(requested_precision));
+            }
+            else
+            {
+                output_precision = precision;
+            }
+        }
+    }
+
     return true;
 }
 
@@ -440,8 +515,10 @@ void AzureEyeModel::cleanup(cv::GStreamingCompiled &pipeline, const cv::Mat &las
 {
     this->restarting = false;
 
-    util::put_text(last_bgr, "Loading Model");
-    rtsp::update_data_result(last_bgr);
+    // The RTSP streams may still be sending out last_bgr, so mark up a copy of it.
+    cv::Mat loading_bgr = last_bgr.clone();
+    util::put_text(loading_bgr, "Loading Model");
+    rtsp::update_data_result(loading_bgr);
 }
 
 void AzureEyeModel::handle_h264_output(cv::optional<std::vector<uint8_t>> &out_h264, const cv::optional<int64_t> &out_h264_ts,
@@ -467,7 +544,7 @@ void AzureEyeModel::handle_h264_output(cv::optional<std::vector<uint8_t>> &out_h
     rtsp::update_data_h264(frame);
 }
 
-void AzureEyeModel::handle_new_inference_for_time_alignment(int64_t inference_ts, std::function<void(cv::Mat&)> f_to_apply_to_each_frame)
+void AzureEyeModel::handle_new_inference_for_time_alignment(int64_t inference_ts, std::function<void(cv::Mat&, double, double)> f_to_apply_to_each_frame)
 {
     if (!this->align_frames_in_time)
     {
@@ -480,16 +557,22 @@ void AzureEyeModel::handle_new_inference_for_time_alignment(int64_t inference_ts
 
     // Find all the frames that are either time-aligned or older than the time-aligned frame
     // (and remove them from the buffer)
-    auto frames_to_draw_on = this->timestamped_frames.get_best_match_and_older(inference_ts);
+    auto frames_and_sizes = this->timestamped_frames.get_best_match_and_older(inference_ts);
 
-    // Draw our bounding boxes (or masks, or whatever) over each one and release them in a batch to the RTSP server
-    for (auto &frame : frames_to_draw_on)
+    // Draw our bounding boxes (or masks, or whatever) over each one and release them in a batch to the RTSP server.
+    // Draw on them at whatever size they were stored at, scaling the inference to match, rather than blowing them back up first.
+    std::vector<cv::Mat> frames_to_draw_on;
+    frames_to_draw_on.reserve(frames_and_sizes.size());
+    for (auto &frame_and_size : frames_and_sizes)
     {
-        f_to_apply_to_each_frame(frame);
+        cv::Mat &frame = std::get<0>(frame_and_size);
+        const cv::Size &original_size = std::get<1>(frame_and_size);
+        f_to_apply_to_each_frame(frame, static_cast<double>(frame.cols) / original_size.width, static_cast<double>(frame.rows) / original_size.height);
         if (!this->status_msg.empty())
         {
             util::put_text(frame, this->status_msg);
         }
+        frames_to_draw_on.push_back(std::move(frame));
     }
 
     #ifdef DEBUG_TIME_ALIGNMENT
@@ -92,6 +92,16 @@ public:
      */
     static void clear_model_storage();
 
+    /**
+     * Set the output precision ("FP32", "FP16", or "U8") that we compile .xml and .onnx models to. Lower precisions shrink
+     * the output tensors that go through G-API on every inference, and the parsers accept all of them. U8 is only meant for
+     * segmentation masks, so other types of model get FP16 if it is asked for. A model's config.json can override this
+     * with an "OutputPrecision" property.
+     *
+     * @returns False (leaving the setting as it was) if the given precision is not one of the above.
+     */
+    static bool set_output_precision(const std::string &precision);
+
     /** Returns the model's resolution. */
     cv::gapi::mx::Camera::Mode get_resolution() const;
 
@@ -132,8 +142,12 @@ protected:
     /** Write the H264 outputs to a file if videofile is non-empty and we have a result ready in the out_264 node. Also writes to the RTSP feed. */
     void handle_h264_output(cv::optional<std::vector<uint8_t>> &out_h264, const cv::optional<int64_t> &out_h264_ts, const cv::optional<int64_t> &out_h264_seqno, std::ofstream &ofs) const;
 
-    /** Aligns the new inference in time with frames and calls the given lambda on each frame. Use this lambda to mark up the frames using this new inference. */
-    void handle_new_inference_for_time_alignment(int64_t inference_ts, std::function<void(cv::Mat&)> f_to_apply_to_each_frame);
+    /**
+     * Aligns the new inference in time with frames and calls the given lambda on each frame. Use this lambda to mark up the frames using this new inference.
+     * The frames may have been stored smaller than the camera frames the inference is in the coordinates of, so the lambda also gets how much
+     * to scale those coordinates by in x and y.
+     */
+    void handle_new_inference_for_time_alignment(int64_t inference_ts, std::function<void(cv::Mat&, double, double)> f_to_apply_to_each_frame);
 
     /** Use adpative logging to log the inference message so that it does not pollute the log files */
     void log_inference(const std::string &msg);
@@ -7,6 +7,7 @@
 #include <thread>
 
 // Third party includes
+#include <opencv2/core/hal/intrin.hpp>
 #include <opencv2/gapi/mx.hpp>
 #include <opencv2/gapi/core.hpp>
 #include <opencv2/gapi/infer.hpp>
@@ -20,6 +21,7 @@
 #include "../util/helper.hpp"
 #include "../iot/iot_interface.hpp"
 #include "../kernels/binaryunet_kernels.hpp"
+#include "../kernels/tuning.hpp"
 #include "../streaming/rtsp.hpp"
 
 namespace model {
@@ -185,6 +187,48 @@ void BinaryUnetModel::handle_bgr_output(const cv::optional<cv::Mat> &out_bgr, co
     this->save_retraining_data(last_bgr);
 }
 
+/** These are blending coefficients for adding the mask to the image: alpha * image + beta * mask, in 8.8 fixed point. */
+static const int BLEND_ALPHA_Q8 = 205;
+static const double BLEND_BETA = 1.0 - BLEND_ALPHA_Q8 / 256.0;
+
+/**
+ * Blends `frame` (CV_8UC3) in place as (frame * alpha + term) >> 8, where `term` (CV_16UC3, same size) already holds
+ * beta * mask in 8.8 fixed point plus the rounding bias. The worst case is 255 * 205 + 255 * 51 + 128 = 52275 + 13005 + 128 = 65408 < 2^16, so it all fits in 16 bits.
+ */
+static void blend_in_place(cv::Mat &frame, const cv::Mat &term)
+{
+    CV_Assert(frame.type() == CV_8UC3);
+    CV_Assert(term.type() == CV_16UC3);
+    CV_Assert(frame.size() == term.size());
+
+    const int n = frame.cols * frame.channels();
+    for (int y = 0; y < frame.rows; y++)
+    {
+        uchar *dst = frame.ptr<uchar>(y);
+        const ushort *add = term.ptr<ushort>(y);
+        int i = 0;
+
+#if CV_SIMD
+        constexpr int lanes = cv::v_uint8::nlanes;
+        constexpr int half = cv::v_uint16::nlanes;
+        const cv::v_uint16 v_alpha = cv::vx_setall_u16(static_cast<ushort>(BLEND_ALPHA_Q8));
+        for (; i <= n - lanes; i += lanes)
+        {
+            cv::v_uint16 lo, hi;
+            cv::v_expand(cv::vx_load(dst + i), lo, hi);
+            lo = cv::v_mul_wrap(lo, v_alpha) + cv::vx_load(add + i);
+            hi = cv::v_mul_wrap(hi, v_alpha) + cv::vx_load(add + i + half);
+            cv::v_store(dst + i, cv::v_pack(cv::v_shr<8>(lo), cv::v_shr<8>(hi)));
+        }
+#endif
+
+        for (; i < n; i++)
+        {
+            dst[i] = static_cast<uchar>((dst[i] * BLEND_ALPHA_Q8 + add[i]) >> 8);
+        }
+    }
+}
+
 void BinaryUnetModel::preview(cv::Mat &frame, const cv::Mat& last_mask) const
 {
     // If we haven't gotten a neural network inference yet, we can't preview.
@@ -193,29 +237,25 @@ void BinaryUnetModel::preview(cv::Mat &frame, const cv::Mat& last_mask) const
         return;
     }
 
-    // create a BGR mask
-    cv::Mat g_prob = last_mask > 0;
-    cv::Mat g;
-    g_prob.convertTo(g, CV_8U);
-
-    cv::Mat r = (1 - g);
-    cv::Mat b(r.size(), CV_8UC1, cv::Scalar(0));
-
-    std::vector<cv::Mat> channels{ b, g, r };
-    cv::Mat show_mask;
-    cv::merge(channels, show_mask);
-    show_mask *= 255;
-
-    cv::resize(show_mask, show_mask, frame.size());
-
-    // These are blending coefficients for adding the mask
-    // to the image: alpha * image + beta * mask
-    float alpha = 0.8;
-    float beta = 1 - alpha;
+    // The blend term only changes when the mask (or the frame size) does, so build it once and reuse it for every frame until then.
+    if ((this->blend_generation != this->mask_generation) || (this->blend_term.size() != frame.size()))
+    {
+        // create a BGR mask: green where the network found something, red everywhere else
+        cv::Mat g = last_mask > 0;
+        cv::Mat r = 255 - g;
+        cv::Mat b(r.size(), CV_8UC1, cv::Scalar(0));
+
+        std::vector<cv::Mat> channels{ b, g, r };
+        cv::Mat show_mask;
+        cv::merge(channels, show_mask);
+        cv::resize(show_mask, show_mask, frame.size());
+
+        // Premultiply by beta in 8.8 fixed point and fold in the rounding bias.
+        show_mask.convertTo(this->blend_term, CV_16U, BLEND_BETA * 256.0, 128.0);
+        this->blend_generation = this->mask_generation;
+    }
 
-    cv::Mat dst;
-    cv::addWeighted(frame, alpha, show_mask, beta, 0.0, dst);
-    dst.copyTo(frame);
+    blend_in_place(frame, this->blend_term);
 }
 
 void BinaryUnetModel::handle_inference_output(const cv::optional<cv::Mat> &out_mask, const cv::optional<int64_t> &inference_ts, cv::Mat &last_mask, float threshold)
@@ -228,6 +268,9 @@ void BinaryUnetModel::handle_inference_output(const cv::optional<cv::Mat> &out_m
     // This comes from the same branch in the G-API graph as out_mask, and so must have a value if out_mask does.
     CV_Assert(inference_ts.has_value());
 
+    // The threshold can be re-tuned through the module twin while we run.
+    threshold = tuning::get(tuning::Param::CONFIDENCE_THRESHOLD, threshold);
+
     // Create a mask - everywhere that the network has confidence greater than threshold
     cv::Mat mask_vals(*out_mask > threshold);
 
@@ -260,11 +303,12 @@ void BinaryUnetModel::handle_inference_output(const cv::optional<cv::Mat> &out_m
 
     // Now that we have a new inference, let's cache it.
     last_mask = *out_mask;
+    this->mask_generation++;
 
     // If we want to time-align our network inferences with camera frames, we need to
     // do that here (now that we have a new inference to align in time with the frames we've been saving).
     // The super class will check for us and handle this appropriately.
-    auto f_to_call_on_each_frame = [last_mask, this](cv::Mat &frame){ this->preview(frame, last_mask); };
+    auto f_to_call_on_each_frame = [last_mask, this](cv::Mat &frame, double, double){ this->preview(frame, last_mask); };
     this->handle_new_inference_for_time_alignment(inference_ts, f_to_call_on_each_frame);
 }
 
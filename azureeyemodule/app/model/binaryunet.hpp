@@ -8,6 +8,7 @@
 #pragma once
 
 // Standard library includes
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -42,6 +43,14 @@ public:
     void run(cv::GStreamingCompiled* pipeline) override;
 
 private:
+    /** Bumped every time we get a new mask from the network. */
+    uint64_t mask_generation = 0;
+
+    /** The value of mask_generation that blend_term was built from. */
+    mutable uint64_t blend_generation = 0;
+
+    /** The full resolution mask term that preview() adds to each frame, cached until the mask or the frame size changes. */
+    mutable cv::Mat blend_term;
 
     /** Compiles the G-API graph. */
     cv::GStreamingCompiled compile_cv_graph() const;
@@ -29,6 +29,9 @@ namespace model {
 /** A classification network takes a single input and outputs a single output (which we will parse into labels and confidences) */
 G_API_NET(ClassificationNetwork, <cv::GMat(cv::GMat)>, "classification-network");
 
+/** We only report this many of the most confident classes per inference. */
+static const int CLASSIFICATION_TOP_K = 5;
+
 ClassificationModel::ClassificationModel(const std::string &labelfpath, const std::vector<std::string> &modelfpaths, const std::string &mvcmd, const std::string &videofile, const cv::gapi::mx::Camera::Mode &resolution)
     : AzureEyeModel{ modelfpaths, mvcmd, videofile, resolution }, labelfpath(labelfpath), class_labels({})
 {
@@ -93,10 +96,10 @@ cv::GStreamingCompiled ClassificationModel::compile_cv_graph() const
     cv::GOpaque<int64_t> nn_seqno = cv::gapi::streaming::seqNo(nn);
     cv::GOpaque<cv::Size> sz = cv::gapi::streaming::size(bgr);
 
-    // Parse the output of the classification network into class IDs and confidence scores.
+    // Parse the output of the classification network into the class IDs and confidence scores of the top K classes, most confident first.
     cv::GArray<int> ids;
     cv::GArray<float> cfs;
-    std::tie(ids, cfs) = cv::gapi::streaming::parse_class(nn);
+    std::tie(ids, cfs) = cv::gapi::streaming::parse_class(nn, CLASSIFICATION_TOP_K);
 
     // Specify the boundaries of the G-API graph (the inputs and outputs).
     auto graph = cv::GComputation(cv::GIn(in),
@@ -202,15 +205,11 @@ void ClassificationModel::preview(const cv::Mat &rgb, const std::vector<int> &la
     auto largest_confidence = 0.0f;
     int best_label = 0;
 
-    // Go through each class and see if we have found anything larger than threshold,
-    // and keep the largest-confidence detection if so.
-    for (std::size_t i = 0; i < labels.size(); i++)
+    // The parser hands us the classes most confident first, so the best one (if any) is at the front.
+    if (!labels.empty())
     {
-        if (confidences.at(i) > largest_confidence)
-        {
-            largest_confidence = confidences.at(i);
-            best_label = labels.at(i);
-        }
+        largest_confidence = confidences.front();
+        best_label = labels.front();
     }
 
     // Get a new color for each item we detect,
@@ -263,13 +262,14 @@ void ClassificationModel::handle_inference_output(const cv::optional<int64_t> &o
     //      "timestamp": int. Timestamp of the detection.
     // }
     //
-    // Push each of these detection messages into a vector.
+    // Push each of these detection messages into a vector. There is one per top K class, not one per class.
     std::vector<std::string> messages;
+    messages.reserve(out_labels->size());
+    const auto timestamp = std::to_string(*out_nn_ts);
     for (std::size_t i = 0; i < out_labels->size(); i++)
     {
         auto label = util::get_label(out_labels.value()[i], this->class_labels);
         auto confidence = std::to_string(out_confidences.value()[i]);
-        auto timestamp = std::to_string(*out_nn_ts);
 
         std::string str = std::string("{");
         str.append("\"label\": \"").append(label).append("\", ")
@@ -306,7 +306,7 @@ void ClassificationModel::handle_inference_output(const cv::optional<int64_t> &o
     // If we want to time-align our network inferences with camera frames, we need to
     // do that here (now that we have a new inference to align in time with the frames we've been saving).
     // The super class will check for us and handle this appropriately.
-    auto f_to_call_on_each_frame = [last_labels, last_confidences, this](cv::Mat &frame){ this->preview(frame, last_labels, last_confidences); };
+    auto f_to_call_on_each_frame = [last_labels, last_confidences, this](cv::Mat &frame, double, double){ this->preview(frame, last_labels, last_confidences); };
     this->handle_new_inference_for_time_alignment(*out_nn_ts, f_to_call_on_each_frame);
 }
 
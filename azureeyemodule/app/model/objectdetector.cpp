@@ -25,8 +25,23 @@
 
 namespace model {
 
+/** Scales the given boxes (in camera frame coordinates) to a frame that is scale_x by scale_y times the size of the camera frame. */
+static std::vector<cv::Rect> scale_boxes(const std::vector<cv::Rect> &boxes, double scale_x, double scale_y)
+{
+    std::vector<cv::Rect> scaled;
+    scaled.reserve(boxes.size());
+    for (const auto &box : boxes)
+    {
+        scaled.emplace_back(cv::Point(cvRound(box.x * scale_x), cvRound(box.y * scale_y)),
+                            cv::Point(cvRound(box.br().x * scale_x), cvRound(box.br().y * scale_y)));
+    }
+
+    return scaled;
+}
+
 ObjectDetector::ObjectDetector(const std::string &labelfpath, const std::vector<std::string> &modelfpaths, const std::string &mvcmd, const std::string &videofile, const cv::gapi::mx::Camera::Mode &resolution)
-    : AzureEyeModel{ modelfpaths, mvcmd, videofile, resolution }, labelfpath(labelfpath), class_labels({})
+    : AzureEyeModel{ modelfpaths, mvcmd, videofile, resolution }, labelfpath(labelfpath), class_labels({}),
+      detections_overlay(cv::FONT_HERSHEY_SIMPLEX, 0.7, 2)
 {
 }
 
@@ -223,6 +238,7 @@ void ObjectDetector::handle_inference_output(const cv::optional<int64_t> &out_nn
     last_boxes = std::move(*out_boxes);
     last_labels = std::move(*out_labels);
     last_confidences = std::move(*out_confidences);
+    this->detections_generation++;
 
     // If we want to time-align our network inferences with camera frames, we need to
     // do that here (now that we have a new inference to align in time with the frames we've been saving).
@@ -230,7 +246,9 @@ void ObjectDetector::handle_inference_output(const cv::optional<int64_t> &out_nn
     #ifdef DEBUG_TIME_ALIGNMENT
         util::log_debug("Sending a new inference to time algo.");
     #endif
-    auto f_to_call_on_each_frame = [last_boxes, last_labels, last_confidences, this](cv::Mat &frame){ this->preview(frame, last_boxes, last_labels, last_confidences); };
+    auto f_to_call_on_each_frame = [last_boxes, last_labels, last_confidences, this](cv::Mat &frame, double scale_x, double scale_y){
+        this->preview(frame, scale_boxes(last_boxes, scale_x, scale_y), last_labels, last_confidences);
+    };
     this->handle_new_inference_for_time_alignment(*out_nn_ts, f_to_call_on_each_frame);
 }
 
@@ -239,24 +257,33 @@ void ObjectDetector::preview(cv::Mat &rgb, const std::vector<cv::Rect> &boxes, c
     // This method is responsible for marking up the raw BGR frames with the inferences from the
     // neural network. Since all of our object detector networks output bounding boxes, labels, and confidences,
     // let's mark up the frames with those items.
-    for (std::size_t i = 0; i < boxes.size(); i++)
+    //
+    // We stream frames faster than we get inferences, so we only lay out the boxes and text when the detections
+    // (or the frame size) change, and otherwise just draw the overlay we already have.
+    if ((this->overlay_generation != this->detections_generation) || (this->detections_overlay.size() != rgb.size()))
     {
-        // Draw a bounding box around the detected object. Use a new color each time
-        // up to some point, at which point we wrap around and start reusing colors.
-        int color_index = labels[i] % label::colors().size();
-        cv::rectangle(rgb, boxes[i], label::colors().at(color_index), 2);
-
-        // Draw the label. Use the same color. If we can't figure out the label
-        // (because the network output something unexpected, or there is no labels file),
-        // we just use the class index.
-        auto label = util::get_label(labels[i], this->class_labels) + ": " + util::to_string_with_precision(confidences[i], 2);
-        auto origin = boxes[i].tl() + cv::Point(3, 20);
-        auto font = cv::FONT_HERSHEY_SIMPLEX;
-        auto fontscale = 0.7;
-        auto color = cv::Scalar(label::colors().at(color_index));
-        auto thickness = 2;
-        cv::putText(rgb, label, origin, font, fontscale, color, thickness);
+        this->detections_overlay.reset(rgb.size());
+        for (std::size_t i = 0; i < boxes.size(); i++)
+        {
+            // Draw a bounding box around the detected object. Use a new color each time
+            // up to some point, at which point we wrap around and start reusing colors.
+            int color_index = labels[i] % label::colors().size();
+            auto color = cv::Scalar(label::colors().at(color_index));
+            this->detections_overlay.add_rectangle(boxes[i], color, 2);
+
+            // Draw the label. Use the same color. If we can't figure out the label
+            // (because the network output something unexpected, or there is no labels file),
+            // we just use the class index.
+            auto label = util::get_label(labels[i], this->class_labels) + ": ";
+            auto confidence = util::to_string_with_precision(confidences[i], 2);
+            auto origin = boxes[i].tl() + cv::Point(3, 20);
+            this->detections_overlay.add_text(label, confidence, origin, color);
+        }
+
+        this->overlay_generation = this->detections_generation;
     }
+
+    this->detections_overlay.draw(rgb);
 }
 
 void ObjectDetector::handle_bgr_output(cv::optional<cv::Mat> &out_bgr, const cv::optional<int64_t> &out_bgr_ts, cv::Mat &last_bgr, const std::vector<cv::Rect> &last_boxes,
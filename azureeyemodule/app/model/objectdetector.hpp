@@ -3,6 +3,7 @@
 #pragma once
 
 // Standard library includes
+#include <cstdint>
 #include <string>
 
 // Third party includes
@@ -15,6 +16,7 @@
 
 // Local includes
 #include "azureeyemodel.hpp"
+#include "../util/overlay.hpp"
 
 
 namespace model {
@@ -99,6 +101,15 @@ protected:
     virtual bool pull_data_uvc_video(cv::GStreamingCompiled &pipeline);
 
 private:
+    /** Bumped every time we get a new set of detections from the network. */
+    uint64_t detections_generation = 0;
+
+    /** The value of detections_generation that detections_overlay was built from. */
+    mutable uint64_t overlay_generation = 0;
+
+    /** The boxes and labels of the latest detections, built once per inference and drawn onto every frame until the next one. */
+    mutable overlay::Overlay detections_overlay;
+
     /** Marks up the given rgb with the given labels, bounding boxes, and confidences. */
     void preview(cv::Mat &rgb, const std::vector<cv::Rect> &boxes, const std::vector<int> &labels, const std::vector<float> &confidences) const;
 };
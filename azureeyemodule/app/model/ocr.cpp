@@ -2,6 +2,7 @@
 // Licensed under the MIT license.
 
 // Standard library includes
+#include <cmath>
 #include <string>
 #include <thread>
 #include <vector>
@@ -35,6 +36,31 @@ using GMat2 = std::tuple<cv::GMat, cv::GMat>;
 G_API_NET(TextDetection, <GMat2(cv::GMat)>, "sample.custom.text_detect");
 G_API_NET(TextRecognition, <cv::GMat(cv::GMat)>,"sample.custom.text_recogn");
 
+/** Decoded text whose confidence is at or below this gets reported as undecodable. */
+static const double MIN_TEXT_CONFIDENCE = 0.2;
+
+/** Scales the given text boxes (in camera frame coordinates) to a frame that is scale_x by scale_y times the size of the camera frame. */
+static std::vector<cv::RotatedRect> scale_rects(const std::vector<cv::RotatedRect> &rcs, double scale_x, double scale_y)
+{
+    std::vector<cv::RotatedRect> scaled;
+    scaled.reserve(rcs.size());
+    for (const auto &rc : rcs)
+    {
+        // Scale the box's sides along their own directions. If scale_x and scale_y differ, this is the closest
+        // rotated rectangle to the (slightly sheared) box, which is plenty for drawing it.
+        const double angle = rc.angle * CV_PI / 180.0;
+        const double cos_a = std::cos(angle);
+        const double sin_a = std::sin(angle);
+        const cv::Point2f center(static_cast<float>(rc.center.x * scale_x), static_cast<float>(rc.center.y * scale_y));
+        const cv::Size2f size(static_cast<float>(rc.size.width * std::hypot(cos_a * scale_x, sin_a * scale_y)),
+                              static_cast<float>(rc.size.height * std::hypot(sin_a * scale_x, cos_a * scale_y)));
+        const float new_angle = static_cast<float>(std::atan2(sin_a * scale_y, cos_a * scale_x) * 180.0 / CV_PI);
+        scaled.emplace_back(center, size, new_angle);
+    }
+
+    return scaled;
+}
+
 OCRModel::OCRModel(const std::vector<std::string> &modelfpaths, const std::string &mvcmd, const std::string &videofile, const cv::gapi::mx::Camera::Mode &resolution)
         :AzureEyeModel{ modelfpaths, mvcmd, videofile, resolution }, OCRDecoder(ocr::TextDecoder {0, "0123456789abcdefghijklmnopqrstuvwxyz#", '#'})
 {
@@ -243,13 +269,16 @@ void OCRModel::handle_inference_output(const cv::optional<int64_t> &out_nn_ts,
     // Collect all texts and send to IoT Hub
     std::string msg = "{\"Texts\": [";
 
+    // Decode the recognized text in all the rectangles. We only need to know whether each confidence clears
+    // the threshold, which usually doesn't take a full softmax.
+    const auto all_decoded = this->OCRDecoder.decode(temp_text, MIN_TEXT_CONFIDENCE);
+
     const auto num_labels = temp_rcs.size();
     for (std::size_t label_idx = 0; label_idx < num_labels; label_idx++)
     {
-        // Decode the recognized text in the rectangle
-        auto decoded = this->OCRDecoder.decode(temp_text[label_idx]);
+        const auto &decoded = all_decoded[label_idx];
         this->log_inference("Text: \"" + decoded.text + "\"");
-        if (decoded.conf > 0.2)
+        if (decoded.conf > MIN_TEXT_CONFIDENCE)
         {
             curr_textresults.push_back(decoded.text);
             curr_rcsresults.push_back(temp_rcs[label_idx]);
@@ -289,7 +318,7 @@ void OCRModel::handle_inference_output(const cv::optional<int64_t> &out_nn_ts,
     // If we want to time-align our network inferences with camera frames, we need to
     // do that here (now that we have a new inference to align in time with the frames we've been saving).
     // The super class will check for us and handle this appropriately.
-    auto f_to_call_on_each_frame = [last_rcs, last_text, this](cv::Mat &frame){ this->preview(frame, last_rcs, last_text); };
+    auto f_to_call_on_each_frame = [last_rcs, last_text, this](cv::Mat &frame, double scale_x, double scale_y){ this->preview(frame, scale_rects(last_rcs, scale_x, scale_y), last_text); };
     this->handle_new_inference_for_time_alignment(*out_nn_ts, f_to_call_on_each_frame);
 }
 
@@ -6,6 +6,8 @@
 #include <iostream>
 #include <sstream>
 #include <map>
+#include <string>
+#include <unordered_map>
 
 // Third party includes
 #include <opencv2/core/utility.hpp>
@@ -24,10 +26,14 @@
 #include "../util/labels.hpp"
 
 namespace {
-void remap_ssd_ports(const std::unordered_map<std::string, cv::Mat> &onnx,
-                           std::unordered_map<std::string, cv::Mat> &gapi) {
-    // Assemble ONNX-processed outputs back to a single 1x1x200x7 blob
-    // to preserve compatibility with OpenVINO-based SSD pipeline
+/** The most detections we make room for. The same as the old 1x1x200x7 OpenVINO-style blob. */
+const int MAX_DETECTIONS = 200;
+
+void copy_ssd_ports(const std::unordered_map<std::string, cv::Mat> &onnx,
+                    std::unordered_map<std::string, cv::Mat> &gapi) {
+    // The exported TF SSD's outputs have dynamic dimensions, which G-API can't size its outputs from,
+    // so we declare fixed size outputs and copy the network's outputs into them as they are.
+    // The parser reads them in place from there, so there is no repacking.
     const cv::Mat &num_detections = onnx.at("num_detections:0");
     const cv::Mat &detection_boxes = onnx.at("detection_boxes:0");
     const cv::Mat &detection_scores = onnx.at("detection_scores:0");
@@ -37,39 +43,28 @@ void remap_ssd_ports(const std::unordered_map<std::string, cv::Mat> &onnx,
     GAPI_Assert(detection_boxes.depth() == CV_32F);
     GAPI_Assert(detection_scores.depth() == CV_32F);
     GAPI_Assert(detection_classes.depth() == CV_32F);
+    GAPI_Assert(detection_boxes.total() == 4 * detection_scores.total());
+    GAPI_Assert(detection_classes.total() == detection_scores.total());
 
-    cv::Mat &ssd_output = gapi.at("detection_output");
-
-    const int num_objects = static_cast<int>(num_detections.ptr<float>()[0]);
-    const float *in_boxes = detection_boxes.ptr<float>();
-    const float *in_scores = detection_scores.ptr<float>();
-    const float *in_classes = detection_classes.ptr<float>();
-    float *ptr = ssd_output.ptr<float>();
-
-    for (int i = 0; i < num_objects; i++) {
-        ptr[0] = 0.f;               // "image_id"
-        ptr[1] = in_classes[i];     // "label"
-        ptr[2] = in_scores[i];      // "confidence"
-        ptr[3] = in_boxes[4*i + 1]; // left
-        ptr[4] = in_boxes[4*i + 0]; // top
-        ptr[5] = in_boxes[4*i + 3]; // right
-        ptr[6] = in_boxes[4*i + 2]; // bottom
-
-        ptr      += 7;
-        in_boxes += 4;
-    }
-    if (num_objects < ssd_output.size[2]-1) {
-        // put a -1 mark at the end of output blob if there is space left
-        ptr[0] = -1.f;
-    }
+    // Never copy more detections than either side has room for, and don't let the count claim any more than that.
+    const int n = std::min(static_cast<int>(detection_scores.total()), MAX_DETECTIONS);
+    const float n_valid = std::min(std::max(num_detections.ptr<float>()[0], 0.0f), static_cast<float>(n));
+
+    gapi.at("num_detections:0").ptr<float>()[0] = n_valid;
+    std::copy_n(detection_boxes.ptr<float>(), 4 * n, gapi.at("detection_boxes:0").ptr<float>());
+    std::copy_n(detection_scores.ptr<float>(), n, gapi.at("detection_scores:0").ptr<float>());
+    std::copy_n(detection_classes.ptr<float>(), n, gapi.at("detection_classes:0").ptr<float>());
 }
 
 } // anonymous namespace
 
 namespace model {
 
-/** An ONNX SSD network takes a single input and outputs a single output */
-G_API_NET(IntelONNXSSD, <cv::GMat(cv::GMat)>, "com.intel.onnx.ssd");
+/** An ONNX SSD network's four outputs: num_detections, detection_boxes, detection_scores, detection_classes */
+using GONNXSSDOutputs = std::tuple<cv::GMat, cv::GMat, cv::GMat, cv::GMat>;
+
+/** An ONNX SSD network takes a single input and outputs four tensors */
+G_API_NET(IntelONNXSSD, <GONNXSSDOutputs(cv::GMat)>, "com.intel.onnx.ssd");
 
 ONNXSSDModel::ONNXSSDModel(const std::string &labelfpath, const std::vector<std::string> &modelfpaths, const std::string &mvcmd,
              const std::string &videofile, const cv::gapi::mx::Camera::Mode &resolution)
@@ -115,7 +110,11 @@ cv::GStreamingCompiled ONNXSSDModel::compile_cv_graph() const{
     auto bgr = cv::gapi::streaming::desync(prep);
 
     // Run Inference on the full frame
-    auto blob = cv::gapi::infer<IntelONNXSSD>(bgr);
+    cv::GMat num_detections;
+    cv::GMat detection_boxes;
+    cv::GMat detection_scores;
+    cv::GMat detection_classes;
+    std::tie(num_detections, detection_boxes, detection_scores, detection_classes) = cv::gapi::infer<IntelONNXSSD>(bgr);
 
     // Parse the detections and project those to the original image frame
     cv::GOpaque<int64_t> nn_seqno = cv::gapi::streaming::seqNo(bgr);
@@ -125,14 +124,18 @@ cv::GStreamingCompiled ONNXSSDModel::compile_cv_graph() const{
     cv::GArray<float> cfs;
     auto sz = cv::gapi::streaming::size(bgr);
 
-    std::tie(objs, tags, cfs) = cv::gapi::streaming::parseSSDWithConf(blob, sz);
+    // The parser reads the four outputs as they are, so there is no intermediate 7-wide blob to assemble.
+    std::tie(objs, tags, cfs) = cv::gapi::streaming::parseONNXSSDWithConf(num_detections, detection_boxes, detection_scores, detection_classes, sz);
     auto graph_outs = cv::GOut(objs, tags, cfs, bgr, nn_seqno, nn_ts, sz);
 
     // Graph compilation
-    auto kernels = cv::gapi::combine(cv::gapi::mx::kernels(), cv::gapi::kernels<cv::gapi::streaming::GOCVParseSSDWithConf>());
+    auto kernels = cv::gapi::combine(cv::gapi::mx::kernels(), cv::gapi::kernels<cv::gapi::streaming::GOCVParseONNXSSDWithConf>());
     auto detector = cv::gapi::onnx::Params<IntelONNXSSD>{ onnxfpath }
-        .cfgOutputLayers({"detection_output"})
-        .cfgPostProc({cv::GMatDesc{CV_32F, {1,1,200,7}}}, remap_ssd_ports);
+        .cfgOutputLayers({"num_detections:0", "detection_boxes:0", "detection_scores:0", "detection_classes:0"})
+        .cfgPostProc({cv::GMatDesc{CV_32F, {1}},
+                      cv::GMatDesc{CV_32F, {1, MAX_DETECTIONS, 4}},
+                      cv::GMatDesc{CV_32F, {1, MAX_DETECTIONS}},
+                      cv::GMatDesc{CV_32F, {1, MAX_DETECTIONS}}}, copy_ssd_ports);
     auto networks = cv::gapi::networks(detector);
     auto pipeline = cv::GComputation(std::move(graph_ins), std::move(graph_outs))
         .compileStreaming(cv::gapi::mx::Camera::params(),
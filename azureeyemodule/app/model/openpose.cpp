@@ -51,6 +51,28 @@ static const std::pair<int, int> limb_keypoints_ids[] = {
 /** Width of the 'limbs' in viewing stuff */
 const int stick_width = 4;
 
+/** Scales the given poses' keypoints (in camera frame coordinates) to a frame that is scale_x by scale_y times the size of the camera frame. */
+static std::vector<pose::HumanPose> scale_poses(const std::vector<pose::HumanPose> &poses, double scale_x, double scale_y)
+{
+    const cv::Point2f absent_keypoint(-1.0f, -1.0f);
+
+    std::vector<pose::HumanPose> scaled(poses);
+    for (auto &pose : scaled)
+    {
+        for (auto &keypoint : pose.keypoints)
+        {
+            // Absent keypoints have to stay recognizably absent
+            if (keypoint != absent_keypoint)
+            {
+                keypoint.x *= static_cast<float>(scale_x);
+                keypoint.y *= static_cast<float>(scale_y);
+            }
+        }
+    }
+
+    return scaled;
+}
+
 /** Declare an OpenPose network type. Takes one matrix and outputs two matrices (part affinity fields and keypoints). */
 using openpose_output = std::tuple<cv::GMat, cv::GMat>;
 G_API_NET(OpenPoseNetwork, <openpose_output(cv::GMat)>, "com.intel.azure.open-pose");
@@ -306,7 +328,7 @@ void OpenPoseModel::handle_inference_output(const cv::optional<int64_t> &out_nn_
     // If we want to time-align our network inferences with camera frames, we need to
     // do that here (now that we have a new inference to align in time with the frames we've been saving).
     // The super class will check for us and handle this appropriately.
-    auto f_to_call_on_each_frame = [last_poses, this](cv::Mat &frame){ this->preview(frame, last_poses); };
+    auto f_to_call_on_each_frame = [last_poses, this](cv::Mat &frame, double scale_x, double scale_y){ this->preview(frame, scale_poses(last_poses, scale_x, scale_y)); };
     this->handle_new_inference_for_time_alignment(*out_nn_ts, f_to_call_on_each_frame);
 }
 
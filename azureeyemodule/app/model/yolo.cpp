@@ -2,6 +2,7 @@
 // Licensed under the MIT license.
 
 // Standard library includes
+#include <parson.h>
 #include <string>
 #include <thread>
 #include <vector>
@@ -25,6 +26,13 @@ namespace model {
 /** A YOLO network takes a single input and outputs a single output (which we will parse into boxes, labels, and confidences) */
 G_API_NET(YOLONetwork, <cv::GMat(cv::GMat)>, "yolo-network");
 
+/** Multi-scale YOLO networks (like YOLOv3-tiny and YOLOv4-tiny) output one tensor per grid size */
+using YOLOTwoHeadsInfo = std::tuple<cv::GMat, cv::GMat>;
+G_API_NET(YOLOTwoHeadsNetwork, <YOLOTwoHeadsInfo(cv::GMat)>, "yolo-two-heads-network");
+
+/** This is where a model package's config.json ends up once it has been unzipped. */
+static const std::string CONFIG_FPATH = "/app/model/config.json";
+
 YoloModel::YoloModel(const std::string &labelfpath, const std::vector<std::string> &modelfpaths, const std::string &mvcmd, const std::string &videofile, const cv::gapi::mx::Camera::Mode &resolution)
     : ObjectDetector{ labelfpath, modelfpaths, mvcmd, videofile, resolution }
 {
@@ -40,6 +48,9 @@ void YoloModel::run(cv::GStreamingCompiled *pipeline)
         // Read in the labels for classification
         label::load_label_file(this->class_labels, this->labelfpath);
 
+        // Read in the head layout, if the model package gives us one
+        this->load_yolo_params();
+
         // Log some metadata.
         this->log_parameters();
 
@@ -81,18 +92,32 @@ cv::GStreamingCompiled YoloModel::compile_cv_graph() const
     cv::GMat bgr = cv::gapi::streaming::desync(preproc);
     cv::GOpaque<int64_t> nn_ts = cv::gapi::streaming::timestamp(bgr);
 
-    // Here's where we actually run our neural network. It runs on the VPU.
-    cv::GMat nn = cv::gapi::infer<YOLONetwork>(bgr);
-
     // Get some useful metadata.
-    cv::GOpaque<int64_t> nn_seqno = cv::gapi::streaming::seqNo(nn);
     cv::GOpaque<cv::Size> sz = cv::gapi::streaming::size(bgr);
+    cv::GOpaque<int64_t> nn_seqno;
 
-    // Here's where we post-process our network's outputs into bounding boxes, IDs, and confidences.
+    // Here's where we actually run our neural network (on the VPU) and post-process its outputs into
+    // bounding boxes, IDs, and confidences. The network has one output per head.
     cv::GArray<cv::Rect> rcs;
     cv::GArray<int> ids;
     cv::GArray<float> cfs;
-    std::tie(rcs, ids, cfs) = cv::gapi::streaming::parseYoloWithConf(nn, sz);
+    cv::gapi::GNetPackage networks;
+    CV_Assert(this->modelfiles.size() >= 1);
+    if (this->yolo_config.n_heads() == 1)
+    {
+        cv::GMat nn = cv::gapi::infer<YOLONetwork>(bgr);
+        nn_seqno = cv::gapi::streaming::seqNo(nn);
+        std::tie(rcs, ids, cfs) = cv::gapi::streaming::parseYoloWithConf(nn, sz, 0.5f, 0.5f, this->yolo_config);
+        networks = cv::gapi::networks(cv::gapi::mx::Params<YOLONetwork>{this->modelfiles.at(0)});
+    }
+    else
+    {
+        cv::GMat nn0, nn1;
+        std::tie(nn0, nn1) = cv::gapi::infer<YOLOTwoHeadsNetwork>(bgr);
+        nn_seqno = cv::gapi::streaming::seqNo(nn0);
+        std::tie(rcs, ids, cfs) = cv::gapi::streaming::parseYoloWithConf(nn0, nn1, sz, 0.5f, 0.5f, this->yolo_config);
+        networks = cv::gapi::networks(cv::gapi::mx::Params<YOLOTwoHeadsNetwork>{this->modelfiles.at(0)}.cfgOutputLayers({ this->output_layers.at(0), this->output_layers.at(1) }));
+    }
 
     // Specify the boundaries of the G-API graph (the inputs and outputs).
     auto graph = cv::GComputation(cv::GIn(in),
@@ -100,12 +125,8 @@ cv::GStreamingCompiled YoloModel::compile_cv_graph() const
                                            img, img_ts,                             // Raw frame branch
                                            nn_seqno, nn_ts, rcs, ids, cfs, sz));    // Neural network inference branch
 
-    // Pass the actual neural network blob file into the graph. We assume we have a modelfiles of at least length 1.
-    CV_Assert(this->modelfiles.size() >= 1);
-    auto networks = cv::gapi::networks(cv::gapi::mx::Params<YOLONetwork>{this->modelfiles.at(0)});
-
     // Here we wrap up all the kernels (the implementations of the G-API ops) that we need for our graph.
-    auto kernels = cv::gapi::combine(cv::gapi::mx::kernels(), cv::gapi::kernels<cv::gapi::streaming::GOCVParseYoloWithConf>());
+    auto kernels = cv::gapi::combine(cv::gapi::mx::kernels(), cv::gapi::kernels<cv::gapi::streaming::GOCVParseYoloWithConf, cv::gapi::streaming::GOCVParseYoloTwoHeadsWithConf>());
 
     // Compile the graph in streamnig mode; set all the parameters; feed the firmware file into the VPU.
     auto pipeline = graph.compileStreaming(cv::gapi::mx::Camera::params(), cv::compile_args(networks, kernels, cv::gapi::mx::mvcmdFile{ this->mvcmd }));
@@ -116,6 +137,102 @@ cv::GStreamingCompiled YoloModel::compile_cv_graph() const
     return pipeline;
 }
 
+void YoloModel::load_yolo_params()
+{
+    this->yolo_config = yolo::Config();
+    this->output_layers.clear();
+
+    if (!util::file_exists(CONFIG_FPATH))
+    {
+        return;
+    }
+
+    JSON_Value *root_value = json_parse_file(CONFIG_FPATH.c_str());
+    JSON_Object *params = json_object_get_object(json_value_get_object(root_value), "YoloParams");
+    if (params == nullptr)
+    {
+        json_value_free(root_value);
+        return;
+    }
+
+    yolo::Config config;
+    JSON_Array *anchors = json_object_get_array(params, "Anchors");
+    if (anchors != nullptr)
+    {
+        config.anchors.clear();
+        for (size_t i = 0; i < json_array_get_count(anchors); i++)
+        {
+            config.anchors.push_back(static_cast<float>(json_array_get_number(anchors, i)));
+        }
+    }
+
+    JSON_Array *masks = json_object_get_array(params, "Masks");
+    if (masks != nullptr)
+    {
+        for (size_t head = 0; head < json_array_get_count(masks); head++)
+        {
+            JSON_Array *mask = json_array_get_array(masks, head);
+            std::vector<int> indexes;
+            for (size_t i = 0; (mask != nullptr) && (i < json_array_get_count(mask)); i++)
+            {
+                indexes.push_back(static_cast<int>(json_array_get_number(mask, i)));
+            }
+            config.masks.push_back(indexes);
+        }
+    }
+
+    JSON_Array *sides = json_object_get_array(params, "Sides");
+    if (sides != nullptr)
+    {
+        for (size_t i = 0; i < json_array_get_count(sides); i++)
+        {
+            config.sides.push_back(static_cast<int>(json_array_get_number(sides, i)));
+        }
+    }
+
+    JSON_Array *layers = json_object_get_array(params, "OutputLayers");
+    std::vector<std::string> output_layers;
+    if (layers != nullptr)
+    {
+        for (size_t i = 0; i < json_array_get_count(layers); i++)
+        {
+            const char *layer = json_array_get_string(layers, i);
+            output_layers.push_back((layer != nullptr) ? layer : "");
+        }
+    }
+
+    if (json_object_get_value(params, "InputSize") != nullptr)
+    {
+        config.input_size = static_cast<int>(json_object_get_number(params, "InputSize"));
+    }
+
+    if (json_object_get_value(params, "Sigmoid") != nullptr)
+    {
+        config.sigmoid = json_object_get_boolean(params, "Sigmoid") == 1;
+    }
+
+    json_value_free(root_value);
+
+    if (!config.is_valid())
+    {
+        util::log_error("YoloParams in " + CONFIG_FPATH + " are inconsistent. Using the default YOLO configuration instead.");
+        return;
+    }
+    else if (config.n_heads() > 2)
+    {
+        util::log_error("YOLO networks with more than two heads are not supported. Using the default YOLO configuration instead.");
+        return;
+    }
+    else if ((config.n_heads() > 1) && (output_layers.size() != config.n_heads()))
+    {
+        util::log_error("YoloParams need one OutputLayers entry per head. Using the default YOLO configuration instead.");
+        return;
+    }
+
+    this->yolo_config = config;
+    this->output_layers = output_layers;
+}
+
 void YoloModel::log_parameters() const
 {
     // Log all the stuff
@@ -125,6 +242,7 @@ void YoloModel::log_parameters() const
         msg += blob + ", ";
     }
     msg += ", firmware: " + this->mvcmd + ", parser: YOLO, label: " + this->labelfpath + ", classes: " + std::to_string((int)this->class_labels.size());
+    msg += ", heads: " + std::to_string(this->yolo_config.n_heads());
     util::log_info(msg);
 }
 
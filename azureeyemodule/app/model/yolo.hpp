@@ -14,6 +14,7 @@
 
 // Local includes
 #include "objectdetector.hpp"
+#include "../kernels/yolo_decoder.hpp"
 
 
 namespace model {
@@ -42,9 +43,21 @@ public:
     void run(cv::GStreamingCompiled* pipeline) override;
 
 private:
+    /** The grid sizes, anchors, and head layout that we decode the network's outputs with. */
+    yolo::Config yolo_config;
+
+    /** Names of the network's output layers. Only needed if the network has more than one head. */
+    std::vector<std::string> output_layers;
+
     /** Compile the pipeline graph for YOLO. */
     cv::GStreamingCompiled compile_cv_graph() const;
 
+    /**
+     * Reads the optional "YoloParams" object out of the model package's config.json, if there is one.
+     * Falls back to the default (single-head YOLOv2) configuration if there isn't, or if it does not make sense.
+     */
+    void load_yolo_params();
+
     /** Print out all the model's meta information. */
     void log_parameters() const;
 };
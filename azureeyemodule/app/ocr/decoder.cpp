@@ -5,7 +5,18 @@
 // And taken under Apache License 2.0
 // Copyright (C) 2020 Intel Corporation
 
+// Standard library includes
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 //Third party includes
+#include <opencv2/core/hal/intrin.hpp>
 #include <opencv2/gapi.hpp>
 #include <opencv2/gapi/core.hpp>
 #include <opencv2/gapi/cpu/gcpukernel.hpp>
@@ -15,58 +26,141 @@
 
 //Local includes
 #include "decoder.hpp"
+#include "../kernels/tensor.hpp"
 
 namespace ocr {
 
-// Taken from OMZ samples as-is
-template<typename Iter>
-void softmax_and_choose(Iter begin, Iter end, int *argmax, float *prob)
+/** The largest value in a row, where it is, and the largest of the other values. */
+struct Top2
 {
-    auto max_element = std::max_element(begin, end);
-    *argmax = static_cast<int>(std::distance(begin, max_element));
-    float max_val = *max_element;
-    double sum = 0;
-    for (auto i = begin; i != end; i++)
+    int idx;
+    float max_val;
+    float second_val;
+};
+
+/** Folds `x` into a running top two. Ties with the max become the second value. NaNs never win a comparison, so they are skipped. */
+static inline void push_top2(float x, float &max_val, float &second_val)
+{
+    if (x > max_val)
     {
-       sum += std::exp((*i) - max_val);
+        second_val = max_val;
+        max_val = x;
     }
+    else if (x > second_val)
+    {
+        second_val = x;
+    }
+}
 
-    if (std::fabs(sum) < std::numeric_limits<double>::epsilon())
+/** Scalar top two of [row, row + n). Ties go to the first one, as with std::max_element. */
+static Top2 top2_scalar(const float *row, int n)
+{
+    Top2 top{0, row[0], -std::numeric_limits<float>::infinity()};
+    for (int i = 1; i < n; i++)
     {
-        throw std::logic_error("sum can't be equal to zero");
+        if (row[i] > top.max_val)
+        {
+            top.second_val = top.max_val;
+            top.max_val = row[i];
+            top.idx = i;
+        }
+        else if (row[i] > top.second_val)
+        {
+            top.second_val = row[i];
+        }
     }
-    *prob = 1.0f / static_cast<float>(sum);
+
+    return top;
 }
 
-template<typename Iter>
-std::vector<float> softmax(Iter begin, Iter end)
+/** Returns the index of the first largest value in [row, row + n), along with that value and the largest of the others. */
+static Top2 top2(const float *row, int n)
 {
-    std::vector<float> prob(end - begin, 0.f);
-    std::transform(begin, end, prob.begin(), [](float x) { return std::exp(x); });
-    float sum = std::accumulate(prob.begin(), prob.end(), 0.0f);
-    for (int i = 0; i < static_cast<int>(prob.size()); i++)
+#if CV_SIMD
+    constexpr int lanes = cv::v_float32::nlanes;
+    if (n >= lanes)
     {
-        prob[i] /= sum;
+        // Each lane keeps its own top two, which we then merge.
+        cv::v_float32 v_max = cv::vx_load(row);
+        cv::v_float32 v_second = cv::vx_setall_f32(-std::numeric_limits<float>::infinity());
+        int i = lanes;
+        for (; i <= n - lanes; i += lanes)
+        {
+            const cv::v_float32 x = cv::vx_load(row + i);
+            v_second = cv::v_max(v_second, cv::v_min(v_max, x));
+            v_max = cv::v_max(v_max, x);
+        }
+
+        float lane_max[lanes];
+        float lane_second[lanes];
+        cv::v_store(lane_max, v_max);
+        cv::v_store(lane_second, v_second);
+
+        float max_val = -std::numeric_limits<float>::infinity();
+        float second_val = -std::numeric_limits<float>::infinity();
+        for (int k = 0; k < lanes; k++)
+        {
+            push_top2(lane_max[k], max_val, second_val);
+            second_val = std::max(second_val, lane_second[k]);
+        }
+        for (; i < n; i++)
+        {
+            push_top2(row[i], max_val, second_val);
+        }
+
+        // Find where the max was. If there was a NaN in the row, the vector and scalar maxes may disagree
+        // about it and leave us with a value that isn't in the row, so fall back to the scalar pass.
+        for (int idx = 0; idx < n; idx++)
+        {
+            if (row[idx] == max_val)
+            {
+                return Top2{idx, max_val, second_val};
+            }
+        }
+
+        return top2_scalar(row, n);
     }
-    return prob;
+#endif
+
+    return top2_scalar(row, n);
 }
 
-std::string CTCGreedyDecoder(const float *data, const std::size_t sz, const std::string &alphabet, const char pad_symbol, double *conf)
+/** Returns the log of the softmax probability of the largest value in [row, row + n), which is `max_val`. */
+static double log_prob_of_max(const float *row, int n, float max_val)
+{
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        sum += std::exp(static_cast<double>(row[i]) - max_val);
+    }
+    return -std::log(sum);
+}
+
+std::string CTCGreedyDecoder(const float *data, const std::size_t sz, const std::string &alphabet, const char pad_symbol, double *conf, double min_conf)
 {
     std::string res = "";
     bool prev_pad = false;
-    *conf = 1;
 
+    // The confidence is the product of the chosen symbols' softmax probabilities. Each of those is
+    // 1 / sum(exp(x - max)), which we can bound from the top two values alone, with a single exponential:
+    // the runner up contributes exp(second - max), and the others contribute between none and as much as it does.
     const auto num_classes = alphabet.length();
+    const double n_others = static_cast<double>(num_classes) - 1;
+    double log_upper = 0;
+    double log_lower = 0;
+
     for (auto it = data; it != (data+sz); it += num_classes)
     {
-        int argmax = 0;
-        float prob = 0.f;
-
-        softmax_and_choose(it, it + num_classes, &argmax, &prob);
-        (*conf) *= prob;
+        // The argmax of the softmax is the argmax of the logits, so we don't need to normalize to decode.
+        const Top2 top = top2(it, static_cast<int>(num_classes));
+        if (conf != nullptr)
+        {
+            const double runner_up = (num_classes > 1) ? std::exp(static_cast<double>(top.second_val) - top.max_val) : 0.0;
+            log_upper -= std::log1p(runner_up);
+            log_lower -= std::log1p(n_others * runner_up);
+        }
 
-        auto symbol = alphabet[argmax];
+        auto symbol = alphabet[static_cast<size_t>(top.idx)];
         if (symbol != pad_symbol)
         {
             if (res.empty() || prev_pad || (!res.empty() && symbol != res.back()))
@@ -80,106 +174,256 @@ std::string CTCGreedyDecoder(const float *data, const std::size_t sz, const std:
             prev_pad = true;
         }
     }
+
+    if (conf == nullptr)
+    {
+        return res;
+    }
+
+    // If the bounds settle which side of `min_conf` we are on, that's all the caller needs.
+    // Leave a little margin, so that rounding in exp() can't put the answer on the wrong side.
+    const double margin = 1e-6;
+    if (min_conf > 0)
+    {
+        const double log_min_conf = std::log(min_conf);
+        if (log_lower > log_min_conf + margin)
+        {
+            *conf = std::exp(log_lower);
+            return res;
+        }
+        else if (log_upper < log_min_conf - margin)
+        {
+            *conf = std::exp(log_upper);
+            return res;
+        }
+    }
+
+    // Otherwise, normalize each timestep properly.
+    double log_conf = 0;
+    for (auto it = data; it != (data+sz); it += num_classes)
+    {
+        log_conf += log_prob_of_max(it, static_cast<int>(num_classes), top2(it, static_cast<int>(num_classes)).max_val);
+    }
+    *conf = std::exp(log_conf);
+
     return res;
 }
 
+/** Returns log(exp(a) + exp(b)) without leaving log space. */
+static inline float log_sum_exp(float a, float b)
+{
+    if (a == -std::numeric_limits<float>::infinity())
+    {
+        return b;
+    }
+    else if (b == -std::numeric_limits<float>::infinity())
+    {
+        return a;
+    }
+
+    return std::max(a, b) + std::log1p(std::exp(-std::fabs(a - b)));
+}
+
+/** Writes the log-softmax of [begin, end) into `out`. */
+static void log_softmax(const float *begin, const float *end, std::vector<float> &out)
+{
+    const float max_val = *std::max_element(begin, end);
+    double sum = 0;
+    for (auto i = begin; i != end; i++)
+    {
+        sum += std::exp(*i - max_val);
+    }
+
+    const float log_sum = max_val + static_cast<float>(std::log(sum));
+    out.resize(static_cast<size_t>(end - begin));
+    for (size_t i = 0; i < out.size(); i++)
+    {
+        out[i] = begin[i] - log_sum;
+    }
+}
+
+/**
+ * Every prefix the beam search has seen is interned as a node in this trie, so that a beam is just a node ID:
+ * extending a beam is a child lookup rather than a copy of its sentence, and two beams with the same prefix
+ * have the same ID rather than needing a whole-sentence comparison.
+ */
+class PrefixTrie
+{
+public:
+    static constexpr int ROOT = 0;
+
+    void clear()
+    {
+        this->parents.assign(1, -1);
+        this->labels.assign(1, -1);
+        this->children.clear();
+    }
+
+    /** Returns the node for `node`'s prefix extended by `label`, creating it if we haven't seen it. */
+    int child(int node, int label)
+    {
+        // (parent, label) is an exact rolling key for the prefix, so there are no collisions to resolve.
+        const uint64_t key = (static_cast<uint64_t>(node) << 32) | static_cast<uint32_t>(label);
+        auto it = this->children.find(key);
+        if (it != this->children.end())
+        {
+            return it->second;
+        }
+
+        const int id = static_cast<int>(this->parents.size());
+        this->parents.push_back(node);
+        this->labels.push_back(label);
+        this->children.emplace(key, id);
+        return id;
+    }
+
+    /** Returns the last label of the node's prefix, or -1 for the empty prefix. */
+    int last_label(int node) const
+    {
+        return this->labels[static_cast<size_t>(node)];
+    }
+
+    /** Returns the number of nodes in the trie. */
+    size_t size() const
+    {
+        return this->parents.size();
+    }
+
+    /** Spells out the node's prefix. */
+    std::string spell(int node, const std::string &alphabet) const
+    {
+        std::string res = "";
+        for (; node != ROOT; node = this->parents[static_cast<size_t>(node)])
+        {
+            res += alphabet[static_cast<size_t>(this->labels[static_cast<size_t>(node)])];
+        }
+        std::reverse(res.begin(), res.end());
+        return res;
+    }
+
+private:
+    std::vector<int> parents;
+    std::vector<int> labels;
+    std::unordered_map<uint64_t, int> children;
+};
+
+/** A beam: a prefix in the trie, with the log probabilities of its CTC paths ending in a blank and not ending in one. */
+struct LogBeam
+{
+    int node;
+    float log_prob_blank;
+    float log_prob_not_blank;
+
+    float log_prob() const
+    {
+        return log_sum_exp(this->log_prob_blank, this->log_prob_not_blank);
+    }
+};
+
 std::string CTCBeamSearchDecoder(const float *data, const std::size_t sz, const std::string &alphabet, double *conf, int bandwidth)
 {
+    const float log_zero = -std::numeric_limits<float>::infinity();
     const auto num_classes = alphabet.length();
+    const int blank = static_cast<int>(num_classes) - 1;
+
+    // Scratch space, kept across calls since we are called once per text region.
+    static thread_local PrefixTrie trie;
+    static thread_local std::vector<LogBeam> curr;
+    static thread_local std::vector<LogBeam> last;
+    static thread_local std::vector<int> slot_of_node;
+    static thread_local std::vector<float> log_prob;
 
-    std::vector<BeamElement> curr;
-    std::vector<BeamElement> last;
+    trie.clear();
+    curr.clear();
+    last.clear();
+    last.push_back(LogBeam{PrefixTrie::ROOT, 0.f, log_zero});
+
+    // Adds the given log probabilities to the beam for `node`, creating it if this is its first mention this timestep.
+    auto accumulate = [&](int node, float log_prob_blank, float log_prob_not_blank)
+    {
+        if (slot_of_node.size() < trie.size())
+        {
+            slot_of_node.resize(trie.size(), -1);
+        }
 
-    last.push_back(BeamElement{std::vector<int>(), 1.f, 0.f});
+        int &slot = slot_of_node[static_cast<size_t>(node)];
+        if (slot < 0)
+        {
+            slot = static_cast<int>(curr.size());
+            curr.push_back(LogBeam{node, log_prob_blank, log_prob_not_blank});
+        }
+        else
+        {
+            LogBeam &beam = curr[static_cast<size_t>(slot)];
+            beam.log_prob_blank = log_sum_exp(beam.log_prob_blank, log_prob_blank);
+            beam.log_prob_not_blank = log_sum_exp(beam.log_prob_not_blank, log_prob_not_blank);
+        }
+    };
 
     for (auto it = data; it != (data+sz); it += num_classes)
     {
         curr.clear();
+        log_softmax(it, it + num_classes, log_prob);
 
-        std::vector<float> prob = softmax(it, it + num_classes);
-
-        for(const auto& candidate: last)
+        for (const auto &candidate : last)
         {
-            float prob_not_blank = 0.f;
-            const std::vector<int>& candidate_sentence = candidate.sentence;
-            if (!candidate_sentence.empty())
-            {
-                int n = candidate_sentence.back();
-                prob_not_blank = candidate.prob_not_blank * prob[n];
-            }
-            float prob_blank = candidate.prob() * prob[num_classes - 1];
+            const int last_label = trie.last_label(candidate.node);
+            const float candidate_log_prob = candidate.log_prob();
 
-            auto check_res = std::find_if(curr.begin(),
-                                          curr.end(),
-                                          [&candidate_sentence](const BeamElement& n) {
-                                              return n.sentence == candidate_sentence;
-                                          });
+            // The candidate's own prefix: either a blank, or a repeat of its last char collapsing into it.
+            const float stay_not_blank = (last_label >= 0) ? candidate.log_prob_not_blank + log_prob[static_cast<size_t>(last_label)] : log_zero;
+            accumulate(candidate.node, candidate_log_prob + log_prob[static_cast<size_t>(blank)], stay_not_blank);
 
-            if (check_res == std::end(curr))
+            // Every extension by one char. A repeat of the last char only extends paths that ended in a blank.
+            for (int i = 0; i < blank; i++)
             {
-                curr.push_back(BeamElement{candidate.sentence, prob_blank, prob_not_blank});
-            }
-            else
-            {
-                check_res->prob_not_blank  += prob_not_blank;
-                if (check_res->prob_blank != 0.f)
-                {
-                    throw std::logic_error("Probability that the last char in CTC-sequence "
-                                           "is the special blank char must be zero here");
-                }
-                check_res->prob_blank = prob_blank;
-            }
-
-            for (int i = 0; i < static_cast<int>(num_classes) - 1; i++)
-            {
-                auto extend = candidate_sentence;
-                extend.push_back(i);
-
-                if (candidate_sentence.size() > 0 && candidate.sentence.back() == i)
-                {
-                    prob_not_blank = prob[i] * candidate.prob_blank;
-                }
-                else
-                {
-                    prob_not_blank = prob[i] * candidate.prob();
-                }
-
-                auto check_res2 = std::find_if(curr.begin(),
-                                              curr.end(),
-                                              [&extend](const BeamElement &n) {
-                                                  return n.sentence == extend;
-                                              });
-                if (check_res2 == std::end(curr))
-                {
-                    curr.push_back(BeamElement{extend, 0.f, prob_not_blank});
-                }
-                else
-                {
-                    check_res2->prob_not_blank += prob_not_blank;
-                }
+                const float base = (i == last_label) ? candidate.log_prob_blank : candidate_log_prob;
+                accumulate(trie.child(candidate.node, i), log_zero, base + log_prob[static_cast<size_t>(i)]);
             }
         }
 
-        sort(curr.begin(), curr.end(), [](const BeamElement &a, const BeamElement &b) -> bool {
-            return a.prob() > b.prob();
-        });
-
-        last.clear();
-        int num_to_copy = std::min(bandwidth, static_cast<int>(curr.size()));
-        for (int b = 0; b < num_to_copy; b++)
+        // Keep the top `bandwidth` beams, without sorting the rest.
+        for (const auto &beam : curr)
         {
-            last.push_back(curr[b]);
+            slot_of_node[static_cast<size_t>(beam.node)] = -1;
         }
+
+        auto more_probable = [](const LogBeam &a, const LogBeam &b) -> bool {
+            return a.log_prob() > b.log_prob();
+        };
+        const size_t num_to_keep = std::min(static_cast<size_t>(std::max(bandwidth, 1)), curr.size());
+        std::nth_element(curr.begin(), curr.begin() + static_cast<std::ptrdiff_t>(num_to_keep) - 1, curr.end(), more_probable);
+        std::sort(curr.begin(), curr.begin() + static_cast<std::ptrdiff_t>(num_to_keep), more_probable);
+
+        last.assign(curr.begin(), curr.begin() + static_cast<std::ptrdiff_t>(num_to_keep));
     }
 
-    *conf = last[0].prob();
-    std::string res="";
-    for (const auto& idx: last[0].sentence)
+    *conf = std::exp(static_cast<double>(last[0].log_prob()));
+    return trie.spell(last[0].node, alphabet);
+}
+
+Decoded TextDecoder::decode(const cv::Mat &text, double min_conf) const
+{
+    // Both decoders read every score, so lower precision outputs are widened in full.
+    static thread_local std::vector<float> widened;
+    const float *data = tensor::as_float(text, widened);
+    const auto sz = text.total();
+    double conf = 1.0;
+    const std::string res = ctc_beam_dec_bw == 0
+            ? CTCGreedyDecoder(data, sz, symbol_set, pad_symbol, &conf, min_conf)
+            : CTCBeamSearchDecoder(data, sz, symbol_set, &conf, ctc_beam_dec_bw);
+    return {res, conf};
+}
+
+std::vector<Decoded> TextDecoder::decode(const std::vector<cv::Mat> &texts, double min_conf) const
+{
+    std::vector<Decoded> decoded;
+    decoded.reserve(texts.size());
+    for (const auto &text : texts)
     {
-        res += alphabet[idx];
+        decoded.push_back(this->decode(text, min_conf));
     }
-
-    return res;
+    return decoded;
 }
 
 } //namespace ocr
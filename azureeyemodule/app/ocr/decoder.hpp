@@ -7,6 +7,7 @@
 #pragma once
 
 // Standard library includes
+#include <string>
 #include <vector>
 
 // Third-party includes
@@ -21,29 +22,16 @@
 namespace ocr
 {
 
-    template<typename Iter> void softmax_and_choose(Iter begin, Iter end, int *argmax, float *prob);
-
-    template<typename Iter> std::vector<float> softmax(Iter begin, Iter end);
-
-    struct BeamElement
-    {
-        /** The sequence of chars that will be a result of the beam element */
-        std::vector<int> sentence;
-
-        /** The probability that the last char in CTC sequence for the beam element is the special blank char */
-        float prob_blank;
-
-        /** The probability that the last char in CTC sequence for the beam element is NOT the special blank char */
-        float prob_not_blank;
-
-        /** The probability of the beam element. */
-        float prob() const
-        {
-            return prob_blank + prob_not_blank;
-        }
-    };
-
-    std::string CTCGreedyDecoder(const float *data, const std::size_t sz, const std::string &alphabet, const char pad_symbol, double *conf);
+    /**
+     * Greedy (best path) CTC decoding of a T x C tensor of logits.
+     * If `conf` is not null, it receives the product over timesteps of the chosen symbol's softmax probability.
+     * If it is null, we skip the normalization entirely and only do the argmaxes.
+     *
+     * If `min_conf` is positive, the caller only wants to know which side of `min_conf` the confidence is on.
+     * We bound the confidence from each timestep's top two logits, and only normalize every timestep over the
+     * whole alphabet if the bounds straddle `min_conf`. Otherwise `conf` gets the bound, which is on the same side.
+     */
+    std::string CTCGreedyDecoder(const float *data, const std::size_t sz, const std::string &alphabet, const char pad_symbol, double *conf, double min_conf=0);
 
     std::string CTCBeamSearchDecoder(const float *data, const std::size_t sz, const std::string &alphabet, double *conf, int bandwidth);
 
@@ -58,17 +46,14 @@ namespace ocr
         std::string symbol_set;
         char pad_symbol;
 
-        Decoded decode(const cv::Mat& text) const
-        {
-            const auto &blob = text;
-            const float *data = blob.ptr<float>();
-            const auto sz = blob.total();
-            double conf = 1.0;
-            const std::string res = ctc_beam_dec_bw == 0
-                    ? CTCGreedyDecoder(data, sz, symbol_set, pad_symbol, &conf)
-                    : CTCBeamSearchDecoder(data, sz, symbol_set, &conf, ctc_beam_dec_bw);
-            return {res, conf};
-        }
+        /**
+         * Decodes one text region's recognizer output. If `min_conf` is positive, the greedy decoder's confidence
+         * is only exact when it has to be to tell whether it is above `min_conf` (see CTCGreedyDecoder).
+         */
+        Decoded decode(const cv::Mat& text, double min_conf=0) const;
+
+        /** Decodes each of a frame's text regions in turn. */
+        std::vector<Decoded> decode(const std::vector<cv::Mat> &texts, double min_conf=0) const;
     };
 
 } // namespace ocr
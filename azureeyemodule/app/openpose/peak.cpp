@@ -7,11 +7,13 @@
 
 // Standard library includes
 #include <algorithm>
+#include <cmath>
 #include <utility>
 #include <vector>
 
 // Third party includes
 #include <opencv2/core/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 
 // Local includes
 #include "peak.hpp"
@@ -24,6 +26,7 @@ namespace peak {
 #define EXTRA_LIMB_IDX1 18
 #define N_PAF_LIMB_PAIRS 19
 #define N_HEATMAP_LIMB_PAIRS 19
+#define N_MID_POINTS 10
 
 Peak::Peak(const int id, const cv::Point2f &pos, const float score)
     : id(id), pos(pos), score(score)
@@ -37,74 +40,215 @@ HumanPoseByPeaksIndices::HumanPoseByPeaksIndices(const int keypoints_number)
     // Nothing to todo
 }
 
+/**
+ * The two PAF channels (x and y components) of a limb, as pointers into their native resolution planes,
+ * so that the line integrals can sample them directly.
+ */
+struct LimbPaf
+{
+    LimbPaf(const UpsampledMap &paf_x, const UpsampledMap &paf_y)
+        : x(paf_x.native().ptr<float>()), y(paf_y.native().ptr<float>()), step(paf_x.native().step1()),
+          rows(paf_x.native().rows), cols(paf_x.native().cols), ratio(static_cast<float>(paf_x.ratio()))
+    {
+        CV_Assert(paf_y.native().step1() == this->step);
+    }
+
+    /** The x component plane */
+    const float *x;
+    /** The y component plane */
+    const float *y;
+    /** Row stride of both planes, in floats */
+    size_t step;
+    /** Native rows */
+    int rows;
+    /** Native columns */
+    int cols;
+    /** Upsampling ratio that the peak coordinates are in */
+    float ratio;
+};
+
 TwoJointsConnection::TwoJointsConnection(const int first_joint_idx, const int second_joint_idx, const float score)
     : first_joint_idx(first_joint_idx), second_joint_idx(second_joint_idx), score(score)
 {
     // Nothing to do
 }
 
-void find_peaks(const std::vector<cv::Mat> &heat_maps, const float min_peaks_distance, std::vector<std::vector<Peak> > &all_peaks, int heat_map_id)
+/**
+ * Appends to `peaks` the pixels of `padded` (a thresholded `width` x `height` block of the heat map, with one pixel of padding
+ * on every side) that are strictly greater than their four neighbors. `origin` is the heat map position of the block's
+ * first (unpadded) pixel.
+ */
+static void scan_for_peaks(const std::vector<float> &padded, int width, int height, const cv::Point &origin, std::vector<cv::Point> &peaks)
 {
-    const float threshold = 0.1f;
+    const int stride = width + 2;
+    for (int y = 0; y < height; y++)
+    {
+        const float *above = &padded[static_cast<size_t>(y) * stride + 1];
+        const float *row = above + stride;
+        const float *below = row + stride;
+        int x = 0;
+
+#if CV_SIMD
+        constexpr int lanes = cv::v_float32::nlanes;
+        for (; x <= width - lanes; x += lanes)
+        {
+            const cv::v_float32 val = cv::vx_load(row + x);
+            const cv::v_float32 is_peak = (val > cv::vx_load(row + x - 1)) & (val > cv::vx_load(row + x + 1)) &
+                                          (val > cv::vx_load(above + x)) & (val > cv::vx_load(below + x));
+            const int mask = cv::v_signmask(is_peak);
+            for (int k = 0; mask != 0 && k < lanes; k++)
+            {
+                if (mask & (1 << k))
+                {
+                    peaks.push_back(cv::Point(origin.x + x + k, origin.y + y));
+                }
+            }
+        }
+#endif
 
-    // Collect all the peaks in each heat map.
-    // A pixel is a peak if its value is greater than all its immediately adjacent pixels.
+        for (; x < width; x++)
+        {
+            const float val = row[x];
+            if ((val > row[x - 1]) && (val > row[x + 1]) && (val > above[x]) && (val > below[x]))
+            {
+                peaks.push_back(cv::Point(origin.x + x, origin.y + y));
+            }
+        }
+    }
+}
 
-    // Collect all peaks across all heat maps into this one vector of 2D points (pixel locations)
-    std::vector<cv::Point> peaks;
+/**
+ * Greedily collapses peaks that are closer than `min_peaks_distance` to an earlier peak in `peaks`,
+ * clearing their entries in `is_actual_peak`.
+ *
+ * Peaks are hashed into a grid of `min_peaks_distance`-sized cells, so each peak only has to be compared
+ * with the peaks in the 3x3 cells around it, rather than with every other peak.
+ */
+static void suppress_close_peaks(const std::vector<cv::Point> &peaks, const float min_peaks_distance, const cv::Size &map_size, std::vector<bool> &is_actual_peak)
+{
+    if (peaks.empty() || (min_peaks_distance <= 0.0f))
+    {
+        return;
+    }
 
-    // Index into the particular heat map this 'thread' will be filling in
-    const cv::Mat &heat_map = heat_maps[heat_map_id];
+    const int cell = std::max(1, static_cast<int>(std::ceil(min_peaks_distance)));
+    const int cols = map_size.width / cell + 1;
+    const int rows = map_size.height / cell + 1;
+    const double min_distance_squared = static_cast<double>(min_peaks_distance) * min_peaks_distance;
 
-    // Convert the heat map into a flat float buffer
-    const float *heat_map_data = heat_map.ptr<float>();
-    size_t heat_map_step = heat_map.step1();
+    // Each grid cell is a linked list (through `next`) of the peaks in it
+    std::vector<int> head(static_cast<size_t>(cols) * rows, -1);
+    std::vector<int> next(peaks.size(), -1);
+    for (int i = static_cast<int>(peaks.size()) - 1; i >= 0; i--)
+    {
+        const size_t c = static_cast<size_t>(peaks[i].y / cell) * cols + peaks[i].x / cell;
+        next[i] = head[c];
+        head[c] = i;
+    }
 
-    // For each row and column in the heat map
-    for (int y = -1; y < heat_map.rows + 1; y++)
+    for (int i = 0; i < static_cast<int>(peaks.size()); i++)
     {
-        for (int x = -1; x < heat_map.cols + 1; x++)
+        if (!is_actual_peak[i])
         {
-            // Determine if pixel at (x, y) is a peak value - a possible keypoint
-            float val = 0;
-            if ((x >= 0) && (y >= 0) && (x < heat_map.cols) && (y < heat_map.rows))
-            {
-                val = heat_map_data[y * heat_map_step + x];
-                val = val >= threshold ? val : 0;
-            }
+            continue;
+        }
 
-            float left_val = 0;
-            if ((y >= 0) && (x < (heat_map.cols - 1)) && (y < heat_map.rows))
+        const int cx = peaks[i].x / cell;
+        const int cy = peaks[i].y / cell;
+        for (int gy = std::max(0, cy - 1); gy <= std::min(rows - 1, cy + 1); gy++)
+        {
+            for (int gx = std::max(0, cx - 1); gx <= std::min(cols - 1, cx + 1); gx++)
             {
-                left_val = heat_map_data[y * heat_map_step + x + 1];
-                left_val = left_val >= threshold ? left_val : 0;
+                for (int j = head[static_cast<size_t>(gy) * cols + gx]; j >= 0; j = next[j])
+                {
+                    // Only later peaks can be collapsed into this one
+                    if (j <= i)
+                    {
+                        continue;
+                    }
+
+                    const int dx = peaks[i].x - peaks[j].x;
+                    const int dy = peaks[i].y - peaks[j].y;
+                    if ((dx * dx + dy * dy) < min_distance_squared)
+                    {
+                        is_actual_peak[j] = false;
+                    }
+                }
             }
+        }
+    }
+}
 
-            float right_val = 0;
-            if ((x > 0) && (y >= 0) && (y < heat_map.rows))
-            {
-                right_val = heat_map_data[y * heat_map_step + x - 1];
-                right_val = right_val >= threshold ? right_val : 0;
-            }
+void find_peaks(const std::vector<UpsampledMap> &heat_maps, const float min_peaks_distance, std::vector<std::vector<Peak> > &all_peaks, int heat_map_id)
+{
+    const float threshold = 0.1f;
+
+    // A pixel of the upsampled heat map is a peak if its value is greater than all its immediately adjacent pixels
+    // (with values below `threshold`, and anything off the map, counting as zero).
+    //
+    // We don't upsample the whole heat map to find them. Most of a heat map is background, and a block of upsampled
+    // pixels whose values are all below the threshold can't contain a peak, so we bound each native cell's block
+    // first and only upsample (and scan) the blocks that might reach the threshold.
+
+    // Index into the particular heat map this 'thread' will be filling in
+    const UpsampledMap &heat_map = heat_maps[heat_map_id];
+    const int ratio = heat_map.ratio();
+
+    cv::Mat bounds;
+    heat_map.block_bounds(bounds);
 
-            float top_val = 0;
-            if ((x >= 0) && (x < heat_map.cols) && (y < (heat_map.rows - 1)))
+    // Collect all peaks across this heat map into this one vector of 2D points (pixel locations, upsampled)
+    std::vector<cv::Point> peaks;
+    const cv::Rect map_rect(cv::Point(0, 0), heat_map.size());
+    cv::Mat window;
+    std::vector<float> padded;
+    for (int cy = 0; cy < bounds.rows; cy++)
+    {
+        const float *row_bounds = bounds.ptr<float>(cy);
+        int cx = 0;
+        while (cx < bounds.cols)
+        {
+            // Find the next run of cells that might reach the threshold
+            if (row_bounds[cx] < threshold)
             {
-                top_val = heat_map_data[(y + 1) * heat_map_step + x];
-                top_val = top_val >= threshold ? top_val : 0;
+                cx++;
+                continue;
             }
-
-            float bottom_val = 0;
-            if ((x >= 0) && (y > 0) && (x < heat_map.cols))
+            const int run_start = cx;
+            while ((cx < bounds.cols) && (row_bounds[cx] >= threshold))
             {
-                bottom_val = heat_map_data[(y - 1) * heat_map_step + x];
-                bottom_val = bottom_val >= threshold ? bottom_val : 0;
+                cx++;
             }
 
-            if ((val > left_val) && (val > right_val) && (val > top_val) && (val > bottom_val))
+            // Upsample the run's blocks into a thresholded copy, padded by one pixel on every side for the neighbor tests.
+            // Whatever the padding loses to clipping is off the map, which counts as zero.
+            const cv::Rect search(run_start * ratio, cy * ratio, (cx - run_start) * ratio, ratio);
+            const cv::Rect roi = cv::Rect(search.x - 1, search.y - 1, search.width + 2, search.height + 2) & map_rect;
+            heat_map.upsample(roi, window);
+
+            const int stride = search.width + 2;
+            padded.assign(static_cast<size_t>(stride) * (search.height + 2), 0.0f);
+            for (int y = 0; y < roi.height; y++)
             {
-                peaks.push_back(cv::Point(x, y));
+                const float *src = window.ptr<float>(y);
+                float *dst = &padded[static_cast<size_t>(roi.y + y - (search.y - 1)) * stride + (roi.x - (search.x - 1))];
+                int x = 0;
+#if CV_SIMD
+                constexpr int lanes = cv::v_float32::nlanes;
+                const cv::v_float32 v_threshold = cv::vx_setall_f32(threshold);
+                for (; x <= roi.width - lanes; x += lanes)
+                {
+                    const cv::v_float32 val = cv::vx_load(src + x);
+                    cv::v_store(dst + x, val & (val >= v_threshold));
+                }
+#endif
+                for (; x < roi.width; x++)
+                {
+                    dst[x] = src[x] >= threshold ? src[x] : 0;
+                }
             }
+
+            scan_for_peaks(padded, search.width, search.height, search.tl(), peaks);
         }
     }
 
@@ -116,20 +260,15 @@ void find_peaks(const std::vector<cv::Mat> &heat_maps, const float min_peaks_dis
     // Determine which peaks are truly peaks
     // Peaks which are too close together are collapsed into a single one.
     std::vector<bool> is_actual_peak(peaks.size(), true);
+    suppress_close_peaks(peaks, min_peaks_distance, heat_map.size(), is_actual_peak);
+
     int peak_counter = 0;
     std::vector<Peak> &peaks_with_score_and_id = all_peaks[heat_map_id];
     for (size_t i = 0; i < peaks.size(); i++)
     {
         if (is_actual_peak[i])
         {
-            for (size_t j = i + 1; j < peaks.size(); j++)
-            {
-                if (sqrt((peaks[i].x - peaks[j].x) * (peaks[i].x - peaks[j].x) + (peaks[i].y - peaks[j].y) * (peaks[i].y - peaks[j].y)) < min_peaks_distance)
-                {
-                    is_actual_peak[j] = false;
-                }
-            }
-            peaks_with_score_and_id.push_back(Peak(peak_counter++, peaks[i], heat_map.at<float>(peaks[i])));
+            peaks_with_score_and_id.push_back(Peak(peak_counter++, peaks[i], heat_map.at(peaks[i])));
         }
     }
 }
@@ -247,14 +386,73 @@ static inline std::vector<TwoJointsConnection> take_most_promising_joint_connect
     return connections;
 }
 
+/**
+ * Bilinearly samples the limb's PAF at the `n` (at most N_MID_POINTS) points (`xs`[i], `ys`[i]), which are in upsampled coordinates,
+ * writing the x and y components into `pred_x` and `pred_y`. We sample the native planes at the matching fractional positions,
+ * which follows the PAF more closely than rounding to the nearest upsampled pixel, and costs four taps per point.
+ */
+static void sample_paf(const LimbPaf &paf, const float *xs, const float *ys, int n, float *pred_x, float *pred_y)
+{
+    // Work out each point's taps and gather them, so that the blending can be done in lanes
+    float fx[N_MID_POINTS], fy[N_MID_POINTS];
+    float x00[N_MID_POINTS], x01[N_MID_POINTS], x10[N_MID_POINTS], x11[N_MID_POINTS];
+    float y00[N_MID_POINTS], y01[N_MID_POINTS], y10[N_MID_POINTS], y11[N_MID_POINTS];
+    for (int i = 0; i < n; i++)
+    {
+        const float sx = std::min(std::max((xs[i] + 0.5f) / paf.ratio - 0.5f, 0.0f), static_cast<float>(paf.cols - 1));
+        const float sy = std::min(std::max((ys[i] + 0.5f) / paf.ratio - 0.5f, 0.0f), static_cast<float>(paf.rows - 1));
+        const int ix0 = static_cast<int>(sx);
+        const int iy0 = static_cast<int>(sy);
+        const int ix1 = std::min(ix0 + 1, paf.cols - 1);
+        const int iy1 = std::min(iy0 + 1, paf.rows - 1);
+        fx[i] = sx - ix0;
+        fy[i] = sy - iy0;
+
+        const size_t row0 = static_cast<size_t>(iy0) * paf.step;
+        const size_t row1 = static_cast<size_t>(iy1) * paf.step;
+        x00[i] = paf.x[row0 + ix0]; x01[i] = paf.x[row0 + ix1]; x10[i] = paf.x[row1 + ix0]; x11[i] = paf.x[row1 + ix1];
+        y00[i] = paf.y[row0 + ix0]; y01[i] = paf.y[row0 + ix1]; y10[i] = paf.y[row1 + ix0]; y11[i] = paf.y[row1 + ix1];
+    }
+
+    int i = 0;
+#if CV_SIMD
+    constexpr int lanes = cv::v_float32::nlanes;
+    for (; i <= n - lanes; i += lanes)
+    {
+        const cv::v_float32 v_fx = cv::vx_load(fx + i);
+        const cv::v_float32 v_fy = cv::vx_load(fy + i);
+        auto blend = [&](const float *t00, const float *t01, const float *t10, const float *t11) -> cv::v_float32
+        {
+            const cv::v_float32 v00 = cv::vx_load(t00 + i);
+            const cv::v_float32 v10 = cv::vx_load(t10 + i);
+            const cv::v_float32 top = v00 + v_fx * (cv::vx_load(t01 + i) - v00);
+            const cv::v_float32 bottom = v10 + v_fx * (cv::vx_load(t11 + i) - v10);
+            return top + v_fy * (bottom - top);
+        };
+        cv::v_store(pred_x + i, blend(x00, x01, x10, x11));
+        cv::v_store(pred_y + i, blend(y00, y01, y10, y11));
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        const float top_x = x00[i] + fx[i] * (x01[i] - x00[i]);
+        const float bottom_x = x10[i] + fx[i] * (x11[i] - x10[i]);
+        pred_x[i] = top_x + fy[i] * (bottom_x - top_x);
+
+        const float top_y = y00[i] + fx[i] * (y01[i] - y00[i]);
+        const float bottom_y = y10[i] + fx[i] * (y11[i] - y10[i]);
+        pred_y[i] = top_y + fy[i] * (bottom_y - top_y);
+    }
+}
+
 static inline void maybe_create_joint_connection(std::vector<TwoJointsConnection> &temp_joint_connections, const Peak &candidateA, const Peak &candidateB,
-                                                 const std::pair<cv::Mat, cv::Mat> &score_mid, const std::vector<cv::Mat> &pafs,
+                                                 const LimbPaf &paf, const int height_n,
                                                  const float mid_points_score_threshold, const float found_mid_points_ratio_threshold, const size_t idxA,
                                                  const size_t idxB)
 {
     // Calculate the normalized vector pointing from A to B
     cv::Point2f pt = candidateA.pos * 0.5 + candidateB.pos * 0.5;
-    cv::Point mid = cv::Point(cvRound(pt.x), cvRound(pt.y));
     cv::Point2f vec = candidateB.pos - candidateA.pos;
     double norm_vec = cv::norm(vec);
     if (norm_vec == 0)
@@ -264,11 +462,13 @@ static inline void maybe_create_joint_connection(std::vector<TwoJointsConnection
     vec /= norm_vec;
 
     // Compute the score for this possible limb by computing an approximate (sampled) line integral along the vector
-    float score = vec.x * score_mid.first.at<float>(mid) + vec.y * score_mid.second.at<float>(mid);
-    int height_n  = pafs[0].rows / 2;
+    float mid_x = 0.0f;
+    float mid_y = 0.0f;
+    sample_paf(paf, &pt.x, &pt.y, 1, &mid_x, &mid_y);
+    float score = vec.x * mid_x + vec.y * mid_y;
     float suc_ratio = 0.0f;
     float mid_score = 0.0f;
-    const int mid_num = 10;
+    const int mid_num = N_MID_POINTS;
     const float score_threshold = -100.0f;
 
     if (score > score_threshold)
@@ -276,11 +476,18 @@ static inline void maybe_create_joint_connection(std::vector<TwoJointsConnection
         float p_sum = 0;
         int p_count = 0;
         cv::Size2f step((candidateB.pos.x - candidateA.pos.x)/(mid_num - 1), (candidateB.pos.y - candidateA.pos.y)/(mid_num - 1));
+        float xs[N_MID_POINTS], ys[N_MID_POINTS];
         for (int n = 0; n < mid_num; n++)
         {
-            cv::Point midPoint(cvRound(candidateA.pos.x + n * step.width), cvRound(candidateA.pos.y + n * step.height));
-            cv::Point2f pred(score_mid.first.at<float>(midPoint), score_mid.second.at<float>(midPoint));
-            score = vec.x * pred.x + vec.y * pred.y;
+            xs[n] = candidateA.pos.x + n * step.width;
+            ys[n] = candidateA.pos.y + n * step.height;
+        }
+
+        float pred_x[N_MID_POINTS], pred_y[N_MID_POINTS];
+        sample_paf(paf, xs, ys, mid_num, pred_x, pred_y);
+        for (int n = 0; n < mid_num; n++)
+        {
+            score = vec.x * pred_x[n] + vec.y * pred_y[n];
             if (score > mid_points_score_threshold)
             {
                 p_sum += score;
@@ -308,8 +515,8 @@ static inline void maybe_create_joint_connection(std::vector<TwoJointsConnection
 static inline std::vector<TwoJointsConnection> create_temp_joint_connections(const size_t njointsA, const size_t njointsB,
                                                                              const std::vector<Peak> &candidates_for_jointA,
                                                                              const std::vector<Peak> &candidates_for_jointB,
-                                                                             const std::pair<cv::Mat, cv::Mat> &score_mid,
-                                                                             const std::vector<cv::Mat> &pafs, const float mid_points_score_threshold,
+                                                                             const LimbPaf &paf, const int height_n,
+                                                                             const float mid_points_score_threshold,
                                                                              const float found_mid_points_ratio_threshold)
 {
     std::vector<TwoJointsConnection> temp_joint_connections;
@@ -320,7 +527,7 @@ static inline std::vector<TwoJointsConnection> create_temp_joint_connections(con
             const Peak &candidateA = candidates_for_jointA[i];
             const Peak &candidateB = candidates_for_jointB[j];
 
-            maybe_create_joint_connection(temp_joint_connections, candidateA, candidateB, score_mid, pafs, mid_points_score_threshold, found_mid_points_ratio_threshold, i, j);
+            maybe_create_joint_connection(temp_joint_connections, candidateA, candidateB, paf, height_n, mid_points_score_threshold, found_mid_points_ratio_threshold, i, j);
         }
     }
 
@@ -354,7 +561,7 @@ static inline void create_poses_from_connections(const std::vector<TwoJointsConn
     }
 }
 
-static inline std::vector<TwoJointsConnection> form_most_promising_joint_connections(const size_t keypoints_number, const std::vector<cv::Mat> &pafs,
+static inline std::vector<TwoJointsConnection> form_most_promising_joint_connections(const size_t keypoints_number, const std::vector<UpsampledMap> &pafs,
                                                                                      const std::pair<int, int> (&limb_ids_paf)[N_PAF_LIMB_PAIRS],
                                                                                      const size_t limb_idx, const size_t njointsA, const size_t njointsB,
                                                                                      const std::vector<Peak> &candidates_for_jointA,
@@ -364,13 +571,14 @@ static inline std::vector<TwoJointsConnection> form_most_promising_joint_connect
 {
         // Get two PAFs - the ones from the front half of the array which correspond to the two we already have
         const int map_idx_offset = keypoints_number + 1;
-        std::pair<cv::Mat, cv::Mat> score_mid = {
+        const LimbPaf paf(
             pafs[limb_ids_paf[limb_idx].first - map_idx_offset], // PAF at index [first limb's index - (nkeypoints + 1)]
             pafs[limb_ids_paf[limb_idx].second - map_idx_offset] // PAF at index [second limb's index - (nkeypoints + 1)]
-        };
+        );
+        const int height_n = pafs[0].rows() / 2;
 
         // Create a temporary list of joint connections - these are possible limbs
-        std::vector<TwoJointsConnection> temp_joint_connections = create_temp_joint_connections(njointsA, njointsB, candidates_for_jointA, candidates_for_jointB, score_mid, pafs, mid_points_score_threshold, found_mid_points_ratio_threshold);
+        std::vector<TwoJointsConnection> temp_joint_connections = create_temp_joint_connections(njointsA, njointsB, candidates_for_jointA, candidates_for_jointB, paf, height_n, mid_points_score_threshold, found_mid_points_ratio_threshold);
 
         // Sort the limbs by their line integral across the PAFs - the ones with the highest score are the ones that
         // are most likely to be real and thereby incorporated into poses
@@ -456,21 +664,19 @@ static inline void maybe_create_possible_poses_from_peaks(const size_t njointsA,
  * (such as neck and right shoulder), we will likely get a good score when computing the line integral, as we
  * will be traveling along the vector field. If on the other hand, the joints are not connected, we will likely
  * travel over the vector field wherever there are maginitude 0 vectors or where we are perpendicular to the vector field.
+ * That part only depends on the peaks and the PAFs, so it is done for all limbs up front (see `group_peaks_to_poses`),
+ * and handed to us in `connections`.
  *
  * @param keypoints_number: The number of keypoints in a typical HumanPose
- * @param pafs: The PAFs
- * @param limb_ids_paf: The array of PAF joint IDs
  * @param limb_ids_heatmap: The array of joint IDs that make up the limbs
  * @param all_peaks: All the peaks by heatmap
- * @param mid_points_score_threshold:
- * @param found_mid_points_ratio_threshold:
+ * @param connections: The most promising connections for this limb (empty if either joint has no peaks)
  * @param candidates: All the candidate peaks for forming into skeletons
  * @param limb_idx: The particular limb (used as an index into the limb arrays)
  * @param possible_poses: We fill this vector with possible poses
  */
-static inline void create_candidate_poses_by_limb(const size_t keypoints_number, const std::vector<cv::Mat> &pafs, const std::pair<int, int> (&limb_ids_paf)[N_PAF_LIMB_PAIRS],
-                                                  const std::pair<int, int> (&limb_ids_heatmap)[N_HEATMAP_LIMB_PAIRS], const std::vector<std::vector<Peak>> &all_peaks,
-                                                  const float mid_points_score_threshold, const float found_mid_points_ratio_threshold,
+static inline void create_candidate_poses_by_limb(const size_t keypoints_number, const std::pair<int, int> (&limb_ids_heatmap)[N_HEATMAP_LIMB_PAIRS],
+                                                  const std::vector<std::vector<Peak>> &all_peaks, const std::vector<TwoJointsConnection> &connections,
                                                   const std::vector<Peak> &candidates, const size_t limb_idx, std::vector<HumanPoseByPeaksIndices> &possible_poses)
 {
     // A 'limb' is made up of two joints.
@@ -492,12 +698,11 @@ static inline void create_candidate_poses_by_limb(const size_t keypoints_number,
     }
     else
     {
-        std::vector<TwoJointsConnection> connections = form_most_promising_joint_connections(keypoints_number, pafs, limb_ids_paf, limb_idx, njointsA, njointsB, candidates_for_jointA, candidates_for_jointB, mid_points_score_threshold, found_mid_points_ratio_threshold);
         create_poses_from_connections(connections, limb_idx, possible_poses, keypoints_number, idx_jointA, idx_jointB, candidates);
     }
 }
 
-void group_peaks_to_poses(const std::vector<std::vector<Peak>> &all_peaks, const std::vector<cv::Mat> &pafs, const size_t keypoints_number,
+void group_peaks_to_poses(const std::vector<std::vector<Peak>> &all_peaks, const std::vector<UpsampledMap> &pafs, const size_t keypoints_number,
                           const float mid_points_score_threshold, const float found_mid_points_ratio_threshold, const int min_joints_number,
                           const float min_subset_score, std::vector<HumanPose> &poses)
 {
@@ -520,11 +725,28 @@ void group_peaks_to_poses(const std::vector<std::vector<Peak>> &all_peaks, const
          candidates.insert(candidates.end(), peaks.begin(), peaks.end());
     }
 
-    // For each PAF pair that makes up a limb, use it to create a list of candidate skeletons
+    // Score the most promising connections for each limb. This only depends on the peaks and the PAFs,
+    // so the limbs are independent of one another and we can do them in parallel.
+    std::vector<std::vector<TwoJointsConnection>> limb_connections(util::array_size(limb_ids_paf));
+    cv::parallel_for_(cv::Range(0, static_cast<int>(limb_connections.size())), [&](const cv::Range &range) {
+        for (int k = range.start; k < range.end; k++)
+        {
+            const std::vector<Peak> &candidates_for_jointA = all_peaks[limb_ids_heatmap[k].first - 1];
+            const std::vector<Peak> &candidates_for_jointB = all_peaks[limb_ids_heatmap[k].second - 1];
+            if (!candidates_for_jointA.empty() && !candidates_for_jointB.empty())
+            {
+                limb_connections[k] = form_most_promising_joint_connections(keypoints_number, pafs, limb_ids_paf, static_cast<size_t>(k), candidates_for_jointA.size(), candidates_for_jointB.size(),
+                                                                            candidates_for_jointA, candidates_for_jointB, mid_points_score_threshold, found_mid_points_ratio_threshold);
+            }
+        }
+    });
+
+    // For each PAF pair that makes up a limb, use its connections to create a list of candidate skeletons.
+    // This has to go in order, since each limb builds on the skeletons of the ones before it.
     std::vector<HumanPoseByPeaksIndices> possible_poses(0, HumanPoseByPeaksIndices(keypoints_number));
     for (size_t k = 0; k < util::array_size(limb_ids_paf); k++)
     {
-        create_candidate_poses_by_limb(keypoints_number, pafs, limb_ids_paf, limb_ids_heatmap, all_peaks, mid_points_score_threshold, found_mid_points_ratio_threshold, candidates, k, possible_poses);
+        create_candidate_poses_by_limb(keypoints_number, limb_ids_heatmap, all_peaks, limb_connections[k], candidates, k, possible_poses);
     }
 
     // For each subset of keypoints in the vector of HumanPoseByPeaksIndices, check if we can form it
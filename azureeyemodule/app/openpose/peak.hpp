@@ -20,6 +20,7 @@
 
 // Local includes
 #include "human_pose.hpp"
+#include "upsampled_map.hpp"
 
 
 namespace pose {
@@ -79,12 +80,15 @@ struct TwoJointsConnection {
  * This is the worker kernel for a parallelized implementation of finding all the peaks in all the heat maps,
  * hence why we just pick out a single heat map.
  *
+ * Peaks are found, and reported, in the coordinates of the upsampled heat maps, but we only upsample the
+ * parts of the heat map that could possibly reach the peak threshold.
+ *
  * @param heat_maps: The heat maps
  * @param min_peaks_distance: If we find two peaks that are not at least this far apart, we combine them into a single one.
  * @param all_peaks: TODO: I assume we fill this in in this function?
  * @param heat_map_id: TODO: I assume we are only finding the peaks from `heat_maps[heat_map_id]`?
  */
-void find_peaks(const std::vector<cv::Mat> &heat_maps, const float min_peaks_distance, std::vector<std::vector<Peak>> &all_peaks, int heat_map_id);
+void find_peaks(const std::vector<UpsampledMap> &heat_maps, const float min_peaks_distance, std::vector<std::vector<Peak>> &all_peaks, int heat_map_id);
 
 /**
  * Produces HumanPose objects - one per person in the image, based on the peaks found in the heat maps.
@@ -103,7 +107,7 @@ void find_peaks(const std::vector<cv::Mat> &heat_maps, const float min_peaks_dis
  *                          its score over njoints is less than this value.
  * @param poses: The vector of poses to fill.
  */
-void group_peaks_to_poses(const std::vector<std::vector<Peak>> &all_peaks, const std::vector<cv::Mat> &pafs, const size_t keypoints_number,
+void group_peaks_to_poses(const std::vector<std::vector<Peak>> &all_peaks, const std::vector<UpsampledMap> &pafs, const size_t keypoints_number,
                           const float mid_points_score_threshold, const float found_mid_points_ratio_threshold, const int min_joints_number,
                           const float min_subset_score, std::vector<HumanPose> &poses);
 
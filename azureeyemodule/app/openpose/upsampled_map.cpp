@@ -0,0 +1,210 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// Standard library includes
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Third-party includes
+#include <opencv2/core/core.hpp>
+
+// Local includes
+#include "upsampled_map.hpp"
+
+namespace pose {
+
+/** The 'A' parameter of the cubic convolution kernel, as used by cv::resize. */
+static const float CUBIC_A = -0.75f;
+
+/** Clamps `i` to [0, n). cv::resize replicates the border pixels for cubic interpolation. */
+static inline int clamp_index(int i, int n)
+{
+    return std::min(std::max(i, 0), n - 1);
+}
+
+UpsampledMap::UpsampledMap(const cv::Mat &native, int ratio)
+    : map(native), factor(ratio), weights(4 * ratio), offsets(ratio)
+{
+    CV_Assert(native.type() == CV_32F);
+    CV_Assert(native.dims == 2);
+    CV_Assert(ratio > 0);
+
+    // Destination pixel d = q * ratio + p samples the source at q + (p + 0.5) / ratio - 0.5,
+    // so its taps and weights only depend on the phase p.
+    for (int p = 0; p < ratio; p++)
+    {
+        const float f = (p + 0.5f) / ratio - 0.5f;
+        const int floor_f = static_cast<int>(std::floor(f));
+        const float x = f - floor_f;
+        this->offsets[p] = floor_f - 1;
+
+        float *w = &this->weights[4 * p];
+        w[0] = ((CUBIC_A * (x + 1) - 5 * CUBIC_A) * (x + 1) + 8 * CUBIC_A) * (x + 1) - 4 * CUBIC_A;
+        w[1] = ((CUBIC_A + 2) * x - (CUBIC_A + 3)) * x * x + 1;
+        w[2] = ((CUBIC_A + 2) * (1 - x) - (CUBIC_A + 3)) * (1 - x) * (1 - x) + 1;
+        w[3] = 1.0f - w[0] - w[1] - w[2];
+    }
+}
+
+const cv::Mat &UpsampledMap::native() const
+{
+    return this->map;
+}
+
+int UpsampledMap::ratio() const
+{
+    return this->factor;
+}
+
+int UpsampledMap::rows() const
+{
+    return this->map.rows * this->factor;
+}
+
+int UpsampledMap::cols() const
+{
+    return this->map.cols * this->factor;
+}
+
+cv::Size UpsampledMap::size() const
+{
+    return cv::Size(this->cols(), this->rows());
+}
+
+float UpsampledMap::at(int x, int y) const
+{
+    x = clamp_index(x, this->cols());
+    y = clamp_index(y, this->rows());
+
+    const int px = x % this->factor;
+    const int py = y % this->factor;
+    const int sx = x / this->factor + this->offsets[px];
+    const int sy = y / this->factor + this->offsets[py];
+    const float *wx = &this->weights[4 * px];
+    const float *wy = &this->weights[4 * py];
+
+    float value = 0.0f;
+    for (int j = 0; j < 4; j++)
+    {
+        const float *src = this->map.ptr<float>(clamp_index(sy + j, this->map.rows));
+        float row = 0.0f;
+        for (int i = 0; i < 4; i++)
+        {
+            row += wx[i] * src[clamp_index(sx + i, this->map.cols)];
+        }
+        value += wy[j] * row;
+    }
+
+    return value;
+}
+
+float UpsampledMap::at(const cv::Point &pt) const
+{
+    return this->at(pt.x, pt.y);
+}
+
+void UpsampledMap::upsample(const cv::Rect &roi, cv::Mat &window) const
+{
+    CV_Assert((roi & cv::Rect(cv::Point(0, 0), this->size())) == roi);
+
+    window.create(roi.size(), CV_32F);
+    if (roi.empty())
+    {
+        return;
+    }
+
+    // Interpolate horizontally along every source row that the window's vertical taps touch...
+    const int last_y = roi.y + roi.height - 1;
+    const int first_row = roi.y / this->factor + this->offsets[roi.y % this->factor];
+    const int last_row = last_y / this->factor + this->offsets[last_y % this->factor] + 3;
+    std::vector<float> horizontal(static_cast<size_t>(last_row - first_row + 1) * roi.width);
+    for (int sy = first_row; sy <= last_row; sy++)
+    {
+        const float *src = this->map.ptr<float>(clamp_index(sy, this->map.rows));
+        float *dst = &horizontal[static_cast<size_t>(sy - first_row) * roi.width];
+        for (int dx = 0; dx < roi.width; dx++)
+        {
+            const int x = roi.x + dx;
+            const int px = x % this->factor;
+            const int sx = x / this->factor + this->offsets[px];
+            const float *wx = &this->weights[4 * px];
+            float value = 0.0f;
+            for (int i = 0; i < 4; i++)
+            {
+                value += wx[i] * src[clamp_index(sx + i, this->map.cols)];
+            }
+            dst[dx] = value;
+        }
+    }
+
+    // ...then vertically.
+    for (int dy = 0; dy < roi.height; dy++)
+    {
+        const int y = roi.y + dy;
+        const int py = y % this->factor;
+        const int base = y / this->factor + this->offsets[py] - first_row;
+        const float *wy = &this->weights[4 * py];
+        float *dst = window.ptr<float>(dy);
+        for (int dx = 0; dx < roi.width; dx++)
+        {
+            float value = 0.0f;
+            for (int j = 0; j < 4; j++)
+            {
+                value += wy[j] * horizontal[static_cast<size_t>(base + j) * roi.width + dx];
+            }
+            dst[dx] = value;
+        }
+    }
+}
+
+void UpsampledMap::block_bounds(cv::Mat &bounds) const
+{
+    // Every upsampled value is a weighted sum of source values, so it is at most the largest magnitude among its taps
+    // times the largest possible sum of weight magnitudes (the cubic weights can be negative, which lets it overshoot).
+    float gain = 0.0f;
+    for (int p = 0; p < this->factor; p++)
+    {
+        const float *w = &this->weights[4 * p];
+        gain = std::max(gain, std::fabs(w[0]) + std::fabs(w[1]) + std::fabs(w[2]) + std::fabs(w[3]));
+    }
+    gain *= gain;
+
+    // The blocks of a cell's upsampled pixels take their taps from this range of cells around it.
+    const int first_tap = *std::min_element(this->offsets.begin(), this->offsets.end());
+    const int last_tap = *std::max_element(this->offsets.begin(), this->offsets.end()) + 3;
+
+    // Separable max filter over the taps' range: along the rows first, then down the columns.
+    cv::Mat horizontal(this->map.rows, this->map.cols, CV_32F);
+    for (int y = 0; y < this->map.rows; y++)
+    {
+        const float *src = this->map.ptr<float>(y);
+        float *dst = horizontal.ptr<float>(y);
+        for (int x = 0; x < this->map.cols; x++)
+        {
+            float m = 0.0f;
+            for (int i = first_tap; i <= last_tap; i++)
+            {
+                m = std::max(m, std::fabs(src[clamp_index(x + i, this->map.cols)]));
+            }
+            dst[x] = m;
+        }
+    }
+
+    bounds.create(this->map.rows, this->map.cols, CV_32F);
+    for (int y = 0; y < this->map.rows; y++)
+    {
+        float *dst = bounds.ptr<float>(y);
+        for (int x = 0; x < this->map.cols; x++)
+        {
+            float m = 0.0f;
+            for (int j = first_tap; j <= last_tap; j++)
+            {
+                m = std::max(m, horizontal.ptr<float>(clamp_index(y + j, this->map.rows))[x]);
+            }
+            dst[x] = gain * m;
+        }
+    }
+}
+
+} // namespace pose
@@ -0,0 +1,77 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+
+// Standard library includes
+#include <vector>
+
+// Third-party includes
+#include <opencv2/core/core.hpp>
+
+namespace pose {
+
+/**
+ * A 2D float map (a heat map or one channel of the PAFs), seen as if it had been upsampled by an integer
+ * factor with cv::resize(..., INTER_CUBIC), but which only computes the upsampled values it is asked for.
+ *
+ * The OpenPose parser works in upsampled coordinates, but only ever reads a small fraction of the upsampled
+ * pixels (around candidate peaks and along candidate limbs), so upsampling every map up front is mostly waste.
+ */
+class UpsampledMap
+{
+public:
+    /**
+     * @param native: The map at network output resolution. Must be CV_32F. We keep a reference to its data, not a copy.
+     * @param ratio: The upsampling factor.
+     */
+    UpsampledMap(const cv::Mat &native, int ratio);
+
+    /** The map at network output resolution. */
+    const cv::Mat &native() const;
+
+    /** The upsampling factor. */
+    int ratio() const;
+
+    /** Number of rows of the upsampled map. */
+    int rows() const;
+
+    /** Number of columns of the upsampled map. */
+    int cols() const;
+
+    /** Size of the upsampled map. */
+    cv::Size size() const;
+
+    /** Returns the upsampled value at (x, y), which is clamped to the map. */
+    float at(int x, int y) const;
+
+    /** Returns the upsampled value at `pt`, which is clamped to the map. */
+    float at(const cv::Point &pt) const;
+
+    /**
+     * Fills `window` with the upsampled values in `roi` (which is in upsampled coordinates and must lie inside the map).
+     * This is what cv::resize would have put there, computed separably for just this window.
+     */
+    void upsample(const cv::Rect &roi, cv::Mat &window) const;
+
+    /**
+     * Fills `bounds` (which has the native size) with an upper bound, for each native cell, on the upsampled values
+     * in the block of upsampled pixels that the cell covers. Blocks whose bound is below some threshold can be skipped
+     * without upsampling them.
+     */
+    void block_bounds(cv::Mat &bounds) const;
+
+private:
+    /** The native resolution map. */
+    cv::Mat map;
+
+    /** The upsampling factor. */
+    int factor;
+
+    /** The four cubic weights for each of the `factor` sub-pixel phases. */
+    std::vector<float> weights;
+
+    /** For each phase, the offset of the first of the four source taps from the destination pixel's source cell. */
+    std::vector<int> offsets;
+};
+
+} // namespace pose
@@ -3,12 +3,14 @@
 
 // Standard library includes
 #include <chrono>
+#include <mutex>
 #include <thread>
+#include <utility>
 
 // Local includes
 #include "framebuffer.hpp"
 #include "resolution.hpp"
-#include "../util/circular_buffer.hpp"
+#include "../util/spsc_circular_buffer.hpp"
 #include "../util/helper.hpp"
 
 // Third party includes
@@ -37,84 +39,101 @@ cv::Mat FrameBuffer::get(const Resolution &resolution)
     // Readers may have to wait for the fps_update thread to update the latest frame,
     // but that shouldn't take long.
 
-    cv::Mat ret;
+    // Frames are never written to once they are cached, so we can hand out shallow copies of them.
+    // If somebody has already resized the current frame to this resolution, we share theirs.
+    cv::Mat frame;
+    uint64_t version;
+    {
+        std::lock_guard<std::mutex> lock(this->cached_frame_mutex);
+        auto it = this->resized_frames.find(resolution);
+        if ((it != this->resized_frames.end()) && (it->second.version == this->cached_frame_version))
+        {
+            return it->second.frame;
+        }
 
-    // Take the mutex in order to read the cached frame (which may
-    // be in the middle of being updated by the FPS thread)
-    this->cached_frame_mutex.lock();
-    this->cached_frame.copyTo(ret);
-    this->cached_frame_mutex.unlock();
+        frame = this->cached_frame;
+        version = this->cached_frame_version;
+    }
 
     // Determine the resolution the caller wants
     int desired_height;
     int desired_width;
     std::tie(desired_height, desired_width) = get_height_and_width(resolution);
 
-    // What resolution is the image that we got?
-    int ret_height = ret.size().height;
-    int ret_width = ret.size().width;
+    // If not the right resolution, we should update. Do this outside the lock,
+    // so that we don't hold up the FPS thread or readers of other resolutions.
+    if ((frame.size().height != desired_height) || (frame.size().width != desired_width))
+    {
+        cv::Mat resized;
+        cv::resize(frame, resized, cv::Size(desired_width, desired_height));
+        frame = resized;
+    }
 
-    // If not the right resolution, we should update.
-    if ((ret_height != desired_height) || (ret_width != desired_width))
+    // Share it with the other readers, unless the cached frame has moved on in the meantime.
     {
-        cv::resize(ret, ret, cv::Size(desired_width, desired_height));
+        std::lock_guard<std::mutex> lock(this->cached_frame_mutex);
+        if (version == this->cached_frame_version)
+        {
+            this->resized_frames[resolution] = ResizedFrame{ version, frame };
+        }
     }
 
-    return ret;
+    return frame;
 }
 
 void FrameBuffer::put(const cv::Mat &frame)
 {
-    // Writers block until they put a frame into the buffer, but nobody actually blocks reading
-    // from the buffer in this design, so we should always succeed without waiting.
-    // Unless in the future we re-use this class for some other purpose or have multiple writers.
-    this->circular_buffer.put(frame);
+    // Writers never block. Callers are expected to check room() before putting a bunch of frames in,
+    // so the buffer should only ever be full if the FPS thread has fallen way behind.
+    if (!this->circular_buffer.put(frame))
+    {
+        util::log_debug("FrameBuffer::put() dropped a frame because the buffer is full.");
+    }
 }
 
 void FrameBuffer::periodically_update_frame()
 {
+    // We pace ourselves against absolute deadlines rather than sleeping for a period after doing our work,
+    // as the latter makes us run slower than the FPS by however long the work (and oversleeping) takes.
+    auto deadline = std::chrono::steady_clock::now();
     while (!this->shut_down)
     {
-        // Try to grab the next frame from the buffer, but it might be empty,
-        // or it might be in the middle of a put(). Either way, we don't have
-        // time to wait on this thread, as we may be running at a high FPS.
+        // Try to grab the next frame from the buffer, but it might be empty.
+        // We don't have time to wait on this thread, as we may be running at a high FPS.
         // We'll just catch it again next time.
         cv::Mat frame;
         bool got = this->circular_buffer.get_no_wait(frame);
 
         // We do need to grab the cached_frame lock though.
+        // Nobody writes to a frame once it is in the buffer, so we can take it over without copying it.
         if (got)
         {
             this->cached_frame_mutex.lock();
-            this->cached_frame = frame.clone();
+            this->cached_frame = std::move(frame);
+            this->cached_frame_version++;
             this->cached_frame_mutex.unlock();
         }
 
-        // Sleep for (1.0 / fps) seconds.
+        // Sleep until the next (1.0 / fps) second tick.
         assert(this->fps != 0);
-        double one_over_fps = 1.0 / (double)this->fps;
-        double sleep_duration_ms = std::ceil(one_over_fps * 1000.0);
-        std::this_thread::sleep_for(std::chrono::milliseconds((int64_t)sleep_duration_ms));
+        const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / (double)this->fps));
+        deadline += period;
+
+        // If we have fallen behind (because the device is loaded), skip the ticks we missed rather than
+        // rushing through them to catch up.
+        const auto now = std::chrono::steady_clock::now();
+        if (deadline < now)
+        {
+            deadline += ((now - deadline) / period + 1) * period;
+        }
+
+        std::this_thread::sleep_until(deadline);
     }
 }
 
 size_t FrameBuffer::room() const
 {
-    auto capacity = this->circular_buffer.capacity();
-    auto size = this->circular_buffer.size_no_wait();
-    if (size > capacity)
-    {
-        // We won the lottery! Someone happened to be updating the circular buffer
-        // in just the right way at just the right time so that calling size_no_wait()
-        // returned something bogus.
-        // Safest thing to do in this most unlikely of circumstances is to return 0.
-        util::log_debug("FrameBuffer::room() got a bogus value from circular_buffer.size_no_wait(): " + std::to_string(size) + " when capacity is " + std::to_string(capacity));
-        return 0;
-    }
-    else
-    {
-        return capacity - size;
-    }
+    return this->circular_buffer.capacity() - this->circular_buffer.size_no_wait();
 }
 
 } // namespace rtsp
\ No newline at end of file
@@ -5,11 +5,14 @@
 
 // Standard library includes
 #include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
 #include <thread>
 
 // Local includes
 #include "resolution.hpp"
-#include "../util/circular_buffer.hpp"
+#include "../util/spsc_circular_buffer.hpp"
 
 // Third party includes
 #include <opencv2/core/utility.hpp>
@@ -52,11 +55,10 @@ public:
     /**
      * Constructor for the FrameBuffer class.
      *
-     * @param max_length: The maximum number of frames to store in the buffer before old ones get written over.
+     * @param max_length: The maximum number of frames to store in the buffer before new ones get dropped.
      *                    If this number is too small, we may get a dump of frames from the neural network
-     *                    of a longer length than we can handle. In that case, we will dump some of those frames
-     *                    as we wrap around the buffer, creating a jump in time in the stream that is jarring
-     *                    to the viewer.
+     *                    of a longer length than we can handle. In that case, we will drop some of those frames,
+     *                    creating a jump in time in the stream that is jarring to the viewer.
      * @param fps: The frames per second at which to update the `get` frame. GStreamer RTSP server will call
      *             the `get()` method at some frames per second, which may be different than this, but if the
      *             FPS values differ, you might send duplicate frames or you might not send frames as often as
@@ -72,23 +74,44 @@ public:
      * We adjust the retrieved frame to the right resolution if it isn't already that resolution.
      * This may block up to as long as it takes for the internal FPS updating thread to update
      * the frame, which should be quite quick.
+     *
+     * The returned frame is shared with every other reader (each frame is resized at most once per
+     * resolution), so callers must treat it as read-only.
      */
     cv::Mat get(const Resolution &resolution);
 
-    /** Put a new frame into the buffer. */
+    /**
+     * Put a new frame into the buffer. The frame is shared rather than copied, so callers must not write to it afterwards.
+     * If there is no room for it (see `room()`), the frame is dropped.
+     *
+     * Only one thread may put frames into a given FrameBuffer.
+     */
     void put(const cv::Mat &frame);
 
-    /** Get the number of frames we still have room for before we start overwriting old ones. */
+    /** Get the number of frames we still have room for before we start dropping new ones. */
     size_t room() const;
 
 private:
-    /** The internal container we use for holding the frames. */
-    circbuf::CircularBuffer<cv::Mat> circular_buffer;
+    /** The internal container we use for holding the frames. We are its only consumer (from the FPS thread), and put() is its only producer. */
+    circbuf::SPSCCircularBuffer<cv::Mat> circular_buffer;
 
     /** This is the latest frame that we have sent (or a default if we haven't sent any yet). */
     cv::Mat cached_frame;
 
-    /** Lock to guard access to the cached frame, which gets read from whatever thread, and written from our internal thread. */
+    /** Incremented every time the cached frame changes, so that we can tell when a resized copy of it has gone stale. */
+    uint64_t cached_frame_version = 0;
+
+    /** A copy of the cached frame at some resolution, along with the version of the cached frame it was made from. */
+    struct ResizedFrame
+    {
+        uint64_t version;
+        cv::Mat frame;
+    };
+
+    /** The cached frame at each resolution that somebody has asked for, shared by all readers of that resolution. */
+    std::map<Resolution, ResizedFrame> resized_frames;
+
+    /** Lock to guard access to the cached frame (and its resized copies), which gets read from whatever thread, and written from our internal thread. */
     std::mutex cached_frame_mutex;
 
     /** The frames per second that we update our cached frame. */
@@ -199,6 +199,15 @@ static const std::string h264_proxy_src_name = "h264_proxy_src0";
 /** Flag to control the state of the H.264 pipeline. */
 static bool h264_pipeline_go = false;
 
+/** Pool of recycled GstBuffers that we copy the H.264 frames into. Created lazily, and recreated whenever a frame outgrows it. */
+static GstBufferPool *h264_buffer_pool = nullptr;
+
+/** The size of each buffer in the H.264 buffer pool. */
+static guint h264_buffer_pool_size = 0;
+
+/** The number of buffers we preallocate in the H.264 buffer pool. It grows past this if the pipeline holds on to more. */
+static const guint H264_BUFFER_POOL_MIN_BUFFERS = 4;
+
 
 /** Tell Gstreamer to read the media clock and use it as-is as the NTP timestamp. */
 static gboolean custom_setup_rtpbin(GstRTSPMedia *media, GstElement *rtpbin)
@@ -303,14 +312,24 @@ static cv::Mat get_frame(const std::string &stream_name)
     }
 }
 
+/** Releases the frame that backs a GstBuffer, once GStreamer is done with the buffer. */
+static void release_frame(gpointer frame)
+{
+    delete static_cast<cv::Mat *>(frame);
+}
+
 /** Callback to call whenever our app source needs another buffer to feed out. */
 static void need_data_callback(GstElement *appsrc, guint unused, StreamParameters *params)
 {
-    // Feed out the buffer
-    cv::Mat frame = get_frame(params->name);
-    guint size = frame.size().width * frame.size().height * frame.channels();
-    GstBuffer *buffer = gst_buffer_new_allocate(nullptr, size, nullptr);
-    gst_buffer_fill(buffer, 0, frame.data, size);
+    // Hand the frame's memory straight to GStreamer rather than copying it. The frame buffer never writes
+    // to a frame once it has handed it out, so all we have to do is hold a reference to it until GStreamer is done.
+    cv::Mat *frame = new cv::Mat(get_frame(params->name));
+    if (!frame->isContinuous())
+    {
+        *frame = frame->clone();
+    }
+    gsize size = frame->total() * frame->elemSize();
+    GstBuffer *buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, frame->data, size, 0, size, frame, release_frame);
 
     // Increment the timestamp.
     GST_BUFFER_PTS(buffer) = params->timestamp;
@@ -321,7 +340,7 @@ static void need_data_callback(GstElement *appsrc, guint unused, StreamParameter
     GstFlowReturn ret;
     g_signal_emit_by_name(appsrc, "push-buffer", buffer, &ret);
 
-    // Clean up after ourselves
+    // Clean up after ourselves (the frame is released once the pipeline drops its reference too)
     gst_buffer_unref(buffer);
 }
 
@@ -704,6 +723,49 @@ static void add_bunch_of_frames(const std::vector<cv::Mat> &mats, FrameBuffer &b
     }
 }
 
+/**
+ * Returns a buffer of the given size from the H.264 buffer pool, (re)creating the pool if it doesn't exist yet
+ * or if its buffers are too small. Falls back to allocating a one-off buffer if the pool can't give us one.
+ */
+static GstBuffer* acquire_h264_buffer(guint size)
+{
+    if ((h264_buffer_pool == nullptr) || (size > h264_buffer_pool_size))
+    {
+        // Outstanding buffers keep a reference to the old pool, and are freed when they come back to it.
+        if (h264_buffer_pool != nullptr)
+        {
+            gst_buffer_pool_set_active(h264_buffer_pool, FALSE);
+            gst_object_unref(h264_buffer_pool);
+        }
+
+        // Leave some headroom, so that the next slightly larger key frame doesn't force yet another pool.
+        guint pool_size = size + size / 2;
+        h264_buffer_pool = gst_buffer_pool_new();
+        GstStructure *config = gst_buffer_pool_get_config(h264_buffer_pool);
+        gst_buffer_pool_config_set_params(config, nullptr, pool_size, H264_BUFFER_POOL_MIN_BUFFERS, 0);
+        if (!gst_buffer_pool_set_config(h264_buffer_pool, config) || !gst_buffer_pool_set_active(h264_buffer_pool, TRUE))
+        {
+            util::log_error("Could not set up a buffer pool for the H.264 stream. Allocating a new buffer for each frame instead.");
+            gst_object_unref(h264_buffer_pool);
+            h264_buffer_pool = nullptr;
+            h264_buffer_pool_size = 0;
+            return gst_buffer_new_allocate(nullptr, size, nullptr);
+        }
+        h264_buffer_pool_size = pool_size;
+    }
+
+    GstBuffer *buffer = nullptr;
+    if (gst_buffer_pool_acquire_buffer(h264_buffer_pool, &buffer, nullptr) != GST_FLOW_OK)
+    {
+        util::log_error("Could not acquire a buffer from the H.264 buffer pool. Allocating a new one instead.");
+        return gst_buffer_new_allocate(nullptr, size, nullptr);
+    }
+
+    // The pool resets the buffer to its full size when it gets it back.
+    gst_buffer_set_size(buffer, size);
+    return buffer;
+}
+
 /** Disconnect the H.264 pipeline's appsrc -> proxysink stub. */
 static void disconnect_h264_pipeline()
 {
@@ -785,11 +847,6 @@ void update_data_h264(const H264 &frame)
     }
     g_list_free(current_connections);
 
-    // Turn our frame into a Gst Buffer
-    guint size = frame.data.size();
-    GstBuffer *buffer = gst_buffer_new_allocate(nullptr, size, nullptr);
-    gst_buffer_fill(buffer, 0, frame.data.data(), size);
-
     // Grab the frame's timestamp
     int64_t ts = frame.timestamp;
 
@@ -825,6 +882,12 @@ void update_data_h264(const H264 &frame)
         util::log_error("Timestamp is less than zero.");
         return;
     }
+
+    // Turn our frame into a Gst Buffer
+    guint size = frame.data.size();
+    GstBuffer *buffer = acquire_h264_buffer(size);
+    gst_buffer_fill(buffer, 0, frame.data.data(), size);
+
     GST_BUFFER_PTS(buffer) = ((GstClockTime)ts) - base_timestamp;
     GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale_int(1, GST_SECOND, h264_context.fps);
 
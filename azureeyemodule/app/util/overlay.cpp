@@ -0,0 +1,161 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// Standard library includes
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+// Local includes
+#include "overlay.hpp"
+
+namespace overlay {
+
+GlyphCache::GlyphCache(int font, double fontscale, int thickness)
+    : font(font), fontscale(fontscale), thickness(thickness), sprites({})
+{
+}
+
+const Sprite &GlyphCache::get(const std::string &text)
+{
+    auto it = this->sprites.find(text);
+    if (it != this->sprites.end())
+    {
+        return it->second;
+    }
+
+    // Render the text onto a scratch canvas with enough margin for the stroke thickness, then keep only the runs it covers.
+    int baseline = 0;
+    const cv::Size text_size = cv::getTextSize(text, this->font, this->fontscale, this->thickness, &baseline);
+    const int margin = 2 * this->thickness;
+    const cv::Point origin(margin, margin + text_size.height);
+    cv::Mat canvas = cv::Mat::zeros(text_size.height + baseline + 2 * margin, text_size.width + 2 * margin, CV_8UC1);
+    cv::putText(canvas, text, origin, this->font, this->fontscale, cv::Scalar(255), this->thickness);
+
+    Sprite sprite;
+    sprite.advance = std::max(text_size.width - this->thickness, 0);
+    for (int y = 0; y < canvas.rows; y++)
+    {
+        const uchar *row = canvas.ptr<uchar>(y);
+        int x = 0;
+        while (x < canvas.cols)
+        {
+            if (row[x] == 0)
+            {
+                x++;
+                continue;
+            }
+
+            const int start = x;
+            while ((x < canvas.cols) && (row[x] != 0))
+            {
+                x++;
+            }
+            sprite.runs.push_back(Span{ y - origin.y, start - origin.x, x - origin.x, cv::Vec3b() });
+        }
+    }
+
+    return this->sprites.emplace(text, std::move(sprite)).first->second;
+}
+
+Overlay::Overlay(int font, double fontscale, int thickness)
+    : frame_size(0, 0), spans({}), glyphs(font, fontscale, thickness)
+{
+}
+
+void Overlay::reset(const cv::Size &frame_size)
+{
+    this->frame_size = frame_size;
+    this->spans.clear();
+}
+
+cv::Size Overlay::size() const
+{
+    return this->frame_size;
+}
+
+void Overlay::add_span(int y, int x0, int x1, const cv::Vec3b &color)
+{
+    if ((y < 0) || (y >= this->frame_size.height))
+    {
+        return;
+    }
+
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, this->frame_size.width);
+    if (x0 < x1)
+    {
+        this->spans.push_back(Span{ y, x0, x1, color });
+    }
+}
+
+void Overlay::add_sprite(const Sprite &sprite, const cv::Point &origin, const cv::Vec3b &color)
+{
+    for (const auto &run : sprite.runs)
+    {
+        this->add_span(origin.y + run.y, origin.x + run.x0, origin.x + run.x1, color);
+    }
+}
+
+void Overlay::add_rectangle(const cv::Rect &rect, const cv::Scalar &color, int thickness)
+{
+    const cv::Vec3b bgr(cv::saturate_cast<uchar>(color[0]), cv::saturate_cast<uchar>(color[1]), cv::saturate_cast<uchar>(color[2]));
+
+    // cv::rectangle centers its lines on the edges, from the top left pixel to the bottom right pixel of the rect.
+    const int before = thickness / 2;
+    const int after = thickness - before;
+    const int left = rect.x - before;
+    const int right = rect.x + rect.width - 1 + after;
+    const int top = rect.y - before;
+    const int bottom = rect.y + rect.height - 1 + after;
+
+    for (int y = top; y < bottom; y++)
+    {
+        if ((y < top + thickness) || (y >= bottom - thickness))
+        {
+            // Top and bottom edges.
+            this->add_span(y, left, right, bgr);
+        }
+        else
+        {
+            // Left and right edges.
+            this->add_span(y, left, left + thickness, bgr);
+            this->add_span(y, right - thickness, right, bgr);
+        }
+    }
+}
+
+void Overlay::add_text(const std::string &stable, const std::string &varying, const cv::Point &origin, const cv::Scalar &color)
+{
+    const cv::Vec3b bgr(cv::saturate_cast<uchar>(color[0]), cv::saturate_cast<uchar>(color[1]), cv::saturate_cast<uchar>(color[2]));
+
+    cv::Point pen = origin;
+    const Sprite &prefix = this->glyphs.get(stable);
+    this->add_sprite(prefix, pen, bgr);
+    pen.x += prefix.advance;
+
+    for (const char c : varying)
+    {
+        const Sprite &glyph = this->glyphs.get(std::string(1, c));
+        this->add_sprite(glyph, pen, bgr);
+        pen.x += glyph.advance;
+    }
+}
+
+void Overlay::draw(cv::Mat &frame) const
+{
+    CV_Assert(frame.type() == CV_8UC3);
+    CV_Assert(frame.size() == this->frame_size);
+
+    for (const auto &span : this->spans)
+    {
+        cv::Vec3b *row = frame.ptr<cv::Vec3b>(span.y);
+        std::fill(row + span.x0, row + span.x1, span.color);
+    }
+}
+
+} // namespace overlay
@@ -0,0 +1,98 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+
+// Standard library includes
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+
+namespace overlay {
+
+/** A horizontal run of overlay pixels, [x0, x1) on row y, all of one color. */
+struct Span
+{
+    int y;
+    int x0;
+    int x1;
+    cv::Vec3b color;
+};
+
+/** A piece of text rendered once, kept as the runs of pixels that the text covers (relative to its origin). */
+struct Sprite
+{
+    /** The runs the text covers. Their color is unused; it is supplied when the sprite is placed. */
+    std::vector<Span> runs;
+
+    /** How far along the baseline the next piece of text should start. */
+    int advance;
+};
+
+/**
+ * Renders text with cv::putText the first time it is asked for, and hands back the cached coverage after that.
+ * Coverage doesn't depend on color, so one sprite serves every color a piece of text is drawn in.
+ */
+class GlyphCache
+{
+public:
+    GlyphCache(int font, double fontscale, int thickness);
+
+    /** Returns the sprite for the given text, rendering it if we haven't seen it before. */
+    const Sprite &get(const std::string &text);
+
+private:
+    int font;
+    double fontscale;
+    int thickness;
+    std::unordered_map<std::string, Sprite> sprites;
+};
+
+/**
+ * A retained overlay: a sparse list of colored pixel runs (boxes and text) that is built once, whenever what it shows changes,
+ * and then drawn onto as many frames as we like in a single pass over the runs.
+ */
+class Overlay
+{
+public:
+    /** Text is drawn with this font. */
+    Overlay(int font, double fontscale, int thickness);
+
+    /** Empties the overlay and sets the size of the frames it will be drawn on. Everything added afterwards is clipped to that size. */
+    void reset(const cv::Size &frame_size);
+
+    /** Returns the frame size given to the last reset(). */
+    cv::Size size() const;
+
+    /** Adds the outline of a rectangle, the way cv::rectangle would draw it with the given thickness. */
+    void add_rectangle(const cv::Rect &rect, const cv::Scalar &color, int thickness);
+
+    /**
+     * Adds text whose baseline starts at `origin`. The `stable` part (a label name, say) is cached as one sprite. The `varying` part
+     * (a confidence, say) is put together from cached single glyph sprites, so that it doesn't miss the cache every time it changes.
+     */
+    void add_text(const std::string &stable, const std::string &varying, const cv::Point &origin, const cv::Scalar &color);
+
+    /** Draws the overlay onto the given CV_8UC3 frame, which must be the size given to reset(). */
+    void draw(cv::Mat &frame) const;
+
+private:
+    /** The frame size we clip to. */
+    cv::Size frame_size;
+
+    /** The runs to draw, in the order they were added (so later ones are drawn on top). */
+    std::vector<Span> spans;
+
+    /** Where the text sprites come from. */
+    GlyphCache glyphs;
+
+    /** Adds the given run, clipped to the frame. */
+    void add_span(int y, int x0, int x1, const cv::Vec3b &color);
+
+    /** Adds the given sprite with its origin at `origin`. */
+    void add_sprite(const Sprite &sprite, const cv::Point &origin, const cv::Vec3b &color);
+};
+
+} // namespace overlay
@@ -0,0 +1,261 @@
+/**
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ *
+ * This file contains a lock-free circular buffer for the case where exactly one thread puts
+ * items into it and exactly one (other) thread gets them out.
+ */
+#pragma once
+
+// Standard library includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace circbuf {
+
+/**
+ * A single-producer, single-consumer version of CircularBuffer.
+ *
+ * Putting and getting never take a lock. The producer only ever writes the tail index and the consumer
+ * only ever writes the head index, and the two live on separate cache lines so that they don't bounce
+ * a line back and forth between the two threads' cores. The only lock is taken when the consumer has to
+ * block waiting for an item, and the producer only touches it if it sees that the consumer is waiting.
+ *
+ * Unlike CircularBuffer, the producer cannot overwrite the oldest item when the buffer is full
+ * (as it does not own the head index), so put() refuses the new item instead.
+ *
+ * It is on the caller to guarantee that there is only ever one thread calling put() and one thread calling
+ * the get methods. Anything else is undefined behavior.
+ */
+template <class T>
+class SPSCCircularBuffer
+{
+public:
+
+    /** Constructs a circular buffer of the given maximum size. */
+    explicit SPSCCircularBuffer(size_t size)
+        : buffer(size), max_size(size)
+    {
+    }
+
+    /** Returns the capacity of the buffer. */
+    size_t capacity() const;
+
+    /** Is the buffer empty? */
+    bool is_empty() const;
+
+    /** Is the buffer full? */
+    bool is_full() const;
+
+    /** Retrieves the next item (moving it out, not copying it). Blocks until we have something to give you. Consumer only. */
+    T get();
+
+    /**
+     * Attempts to retrieve the next item (moving it out, not copying it) into the given reference. Blocks for up to
+     * the given timeout (ms) and returns true if we read something, false otherwise (in which case, the object
+     * will not be filled in). Consumer only.
+     */
+    bool get_with_timeout(T &item, unsigned long int timeout_ms);
+
+    /**
+     * Attempts to retrieve the next item (moving it out, not copying it) into the given reference. Never blocks.
+     * Returns true if successful, false if the buffer is empty. Consumer only.
+     */
+    bool get_no_wait(T &item);
+
+    /**
+     * Returns the current number of items in the buffer. This may already be out of date by the time it returns
+     * if the other thread is busy, but it is always between zero and the capacity.
+     */
+    size_t size_no_wait() const;
+
+    /** Copies the given item into the buffer. Returns false (and drops the item) if the buffer is full. Producer only. */
+    bool put(const T &item);
+
+    /** Moves the given item into the buffer. Returns false (and leaves the item alone) if the buffer is full. Producer only. */
+    bool put(T &&item);
+
+private:
+
+    /** A counter that sits on a cache line of its own. */
+    struct alignas(64) Index
+    {
+        std::atomic<size_t> value{0};
+    };
+
+    /** The underlying storage. Item i of the stream lives in slot i % max_size. */
+    std::vector<T> buffer;
+
+    /** This is the largest that our circular buffer is allowed to grow to. */
+    const size_t max_size;
+
+    /** The total number of items ever read out. Only written by the consumer. */
+    Index head;
+
+    /** The total number of items ever put in. Only written by the producer. */
+    Index tail;
+
+    /** Set by the consumer while it is blocked waiting for an item, so that the producer knows to wake it up. */
+    std::atomic<bool> consumer_waiting{false};
+
+    /** Used only to let the consumer block (and be woken up) when there is nothing to read. */
+    std::mutex wait_mutex;
+
+    /** Signaled by the producer when it puts an item while the consumer is waiting. */
+    std::condition_variable condition;
+
+    /**
+     * Like !is_empty(), but sequentially consistent with the store in put(). The consumer checks this after announcing
+     * that it is waiting, so that either it sees the producer's item or the producer sees that it is waiting.
+     */
+    bool has_published_item() const;
+
+    /** Moves the next item out into `item`. The buffer must not be empty. */
+    void pop(T &item);
+
+    /** Wakes up the consumer if it is blocked waiting for an item. */
+    void notify_consumer();
+};
+
+template<class T>
+size_t SPSCCircularBuffer<T>::capacity() const
+{
+    return this->max_size;
+}
+
+template<class T>
+bool SPSCCircularBuffer<T>::is_empty() const
+{
+    return this->head.value.load(std::memory_order_acquire) == this->tail.value.load(std::memory_order_acquire);
+}
+
+template<class T>
+bool SPSCCircularBuffer<T>::is_full() const
+{
+    return this->size_no_wait() == this->max_size;
+}
+
+template<class T>
+T SPSCCircularBuffer<T>::get()
+{
+    T item;
+    if (!this->get_no_wait(item))
+    {
+        std::unique_lock<std::mutex> lock(this->wait_mutex);
+        this->consumer_waiting.store(true);
+        this->condition.wait(lock, [&]{return this->has_published_item();});
+        this->consumer_waiting.store(false);
+        lock.unlock();
+
+        this->pop(item);
+    }
+
+    return item;
+}
+
+template<class T>
+bool SPSCCircularBuffer<T>::get_with_timeout(T &item, unsigned long int timeout_ms)
+{
+    if (this->get_no_wait(item))
+    {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(this->wait_mutex);
+    this->consumer_waiting.store(true);
+    bool got = this->condition.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]{return this->has_published_item();});
+    this->consumer_waiting.store(false);
+    lock.unlock();
+
+    if (got)
+    {
+        this->pop(item);
+    }
+
+    return got;
+}
+
+template<class T>
+bool SPSCCircularBuffer<T>::get_no_wait(T &item)
+{
+    if (this->is_empty())
+    {
+        return false;
+    }
+
+    this->pop(item);
+    return true;
+}
+
+template<class T>
+size_t SPSCCircularBuffer<T>::size_no_wait() const
+{
+    // Read the tail first: the head can only have caught up to it since, never passed it,
+    // so the difference can't go negative unless the consumer read in between, which we clamp.
+    const size_t tail = this->tail.value.load(std::memory_order_acquire);
+    const size_t head = this->head.value.load(std::memory_order_acquire);
+    if (head > tail)
+    {
+        return 0;
+    }
+
+    return std::min(tail - head, this->max_size);
+}
+
+template<class T>
+bool SPSCCircularBuffer<T>::put(const T &item)
+{
+    T copy(item);
+    return this->put(std::move(copy));
+}
+
+template<class T>
+bool SPSCCircularBuffer<T>::put(T &&item)
+{
+    const size_t tail = this->tail.value.load(std::memory_order_relaxed);
+    if (tail - this->head.value.load(std::memory_order_acquire) >= this->max_size)
+    {
+        return false;
+    }
+
+    this->buffer[tail % this->max_size] = std::move(item);
+
+    // Publish the item. This has to be sequentially consistent with the load in notify_consumer() and with
+    // has_published_item(), so that either we see that the consumer is waiting, or it sees this item before it sleeps.
+    this->tail.value.store(tail + 1, std::memory_order_seq_cst);
+    this->notify_consumer();
+
+    return true;
+}
+
+template<class T>
+bool SPSCCircularBuffer<T>::has_published_item() const
+{
+    return this->tail.value.load(std::memory_order_seq_cst) != this->head.value.load(std::memory_order_relaxed);
+}
+
+template<class T>
+void SPSCCircularBuffer<T>::pop(T &item)
+{
+    const size_t head = this->head.value.load(std::memory_order_relaxed);
+    item = std::move(this->buffer[head % this->max_size]);
+    this->head.value.store(head + 1, std::memory_order_release);
+}
+
+template<class T>
+void SPSCCircularBuffer<T>::notify_consumer()
+{
+    if (this->consumer_waiting.load(std::memory_order_seq_cst))
+    {
+        // Take the lock so that we can't signal in between the consumer checking for an item and going to sleep.
+        std::lock_guard<std::mutex> lock(this->wait_mutex);
+        this->condition.notify_one();
+    }
+}
+
+} // namespace circbuf
@@ -1,150 +1,231 @@
 // Standard library includes
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
 #include <vector>
 
+// Third party includes
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
 // Local includes
 #include "time_aligned_buffer.hpp"
 
 namespace timebuf {
 
+/** JPEG quality for JPEG storage. Low enough to be quick to encode and small, high enough not to be noticeable on a stream. */
+static const int JPEG_QUALITY = 75;
+
+/** How we store frames from now on. */
+static std::atomic<Storage> current_storage(Storage::RAW);
 
-TimeAlignedBuffer::TimeAlignedBuffer(const cv::Mat &default_item)
-    : n_timestamped_frames(10), default_value(default_item)
+bool is_valid_storage(const std::string &storage)
 {
-    // Nothing to do
+    return (storage == "raw") || (storage == "resized") || (storage == "jpeg");
 }
 
-void TimeAlignedBuffer::put(const timestamped_frame_t &frame_and_ts)
+Storage storage_string_to_enum(const std::string &storage)
 {
-    // Add the item
-    if (this->index >= this->timestamped_frames.size())
+    if (storage == "raw")
     {
-        // Add a new slot
-        this->timestamped_frames.push_back(frame_and_ts);
+        return Storage::RAW;
+    }
+    else if (storage == "resized")
+    {
+        return Storage::RESIZED;
+    }
+    else if (storage == "jpeg")
+    {
+        return Storage::JPEG;
     }
     else
     {
-        // Overwrite an old item's slot
-        this->timestamped_frames.at(this->index) = frame_and_ts;
+        throw std::invalid_argument("Invalid time alignment storage: " + storage);
     }
+}
 
-    this->index += 1;
-    if (this->index >= this->n_timestamped_frames)
+std::string storage_to_string(const Storage &storage)
+{
+    switch (storage)
     {
-        this->index = 0;
+        case Storage::RAW:
+            return "raw";
+        case Storage::RESIZED:
+            return "resized";
+        case Storage::JPEG:
+            return "jpeg";
+        default:
+            return "UNKNOWN";
     }
 }
 
-size_t TimeAlignedBuffer::size() const
+void set_storage(const Storage &new_storage)
 {
-    return this->timestamped_frames.size();
+    current_storage = new_storage;
 }
 
-std::vector<cv::Mat> TimeAlignedBuffer::get_best_match_and_older(int64_t timestamp)
+Storage get_storage()
 {
-    // If there is nothing in the buffer yet, let's return a default value.
-    if (this->timestamped_frames.size() == 0)
-    {
-        #ifdef DEBUG_TIME_ALIGNMENT
-            util::log_debug("New Inference: No frames in buffer. Sending cached frame.");
-        #endif
-        return this->default_value;
-    }
-
-    cv::Mat oldest_frame;
-    int64_t oldest_ts = LLONG_MAX;
+    return current_storage;
+}
 
-    int64_t best_match_ts = 0;
-    int64_t smallest_time_difference = LLONG_MAX;
+/** Returns the number of bytes of data in the given (possibly encoded) frame. */
+static size_t frame_bytes(const cv::Mat &frame)
+{
+    return frame.total() * frame.elemSize();
+}
 
-    // Sanity check
-    assert(this->timestamped_frames.size() != 0);
+TimeAlignedBuffer::TimeAlignedBuffer(const cv::Mat &default_item, size_t max_bytes)
+    : max_bytes(max_bytes), default_value(default_item, default_item.size())
+{
+    // Nothing to do
+}
 
-    // Search through the circular buffer for the oldest timestamp and the best matching timestamp.
-    for (const auto &tup : this->timestamped_frames)
+void TimeAlignedBuffer::put(const timestamped_frame_t &frame_and_ts, const cv::Size &stream_size)
+{
+    const cv::Mat &frame = std::get<0>(frame_and_ts);
+    StoredFrame stored{ cv::Mat(), std::get<1>(frame_and_ts), frame.size(), get_storage() };
+
+    // There is no point holding on to more pixels than the stream will show, so shrink the frame to the stream's size
+    // (if that is smaller) for both compact forms. The caller draws on it at that size, which is cheaper too.
+    // If the stream is bigger than the frame, there is nothing to gain by resizing.
+    cv::Mat shrunk = frame;
+    if ((stored.storage != Storage::RAW) && (stream_size.width < frame.cols) && (stream_size.height < frame.rows))
     {
-        auto tup_ts = std::get<1>(tup);
-        if (tup_ts < oldest_ts)
-        {
-            std::tie(oldest_frame, oldest_ts) = tup;
-        }
+        cv::resize(frame, shrunk, stream_size, 0, 0, cv::INTER_AREA);
+    }
+    else if (stored.storage == Storage::RESIZED)
+    {
+        stored.storage = Storage::RAW;
+    }
 
-        // Also find the best match
-        auto timedelta = (tup_ts > timestamp) ? (tup_ts - timestamp) : (timestamp - tup_ts);
-        if (timedelta < smallest_time_difference)
+    switch (stored.storage)
+    {
+        case Storage::RESIZED:
+            stored.data = shrunk;
+            break;
+        case Storage::JPEG:
         {
-           best_match_ts = std::get<1>(tup);
-           smallest_time_difference = timedelta;
+            std::vector<uchar> encoded;
+            if (cv::imencode(".jpg", shrunk, encoded, std::vector<int>{ cv::IMWRITE_JPEG_QUALITY, JPEG_QUALITY }))
+            {
+                stored.data = cv::Mat(encoded, true);
+            }
+            else
+            {
+                util::log_error("Could not JPEG encode a frame for time alignment. Storing it raw instead.");
+                stored.storage = Storage::RAW;
+                stored.data = frame.clone();
+            }
+            break;
         }
+        default:
+            stored.data = frame.clone();
+            break;
     }
 
-    // Sanity check
-    assert(oldest_ts != LLONG_MAX);
-    assert(best_match_ts != 0);
-    assert(smallest_time_difference != LLONG_MAX);
-    #ifdef DEBUG_TIME_ALIGNMENT
-        util::log_debug("New Inference: Matched " + util::timestamp_to_string(timestamp) + " with " + util::timestamp_to_string(best_match_ts));
-    #endif
-
-    if (oldest_ts > timestamp)
+    // Make room by dropping the oldest frames. Those are the ones we are least likely to need, as the network
+    // has presumably already moved on past them by the time we are this far behind.
+    const size_t new_bytes = frame_bytes(stored.data);
+    while (!this->timestamped_frames.empty() && (this->n_bytes + new_bytes > this->max_bytes))
     {
         #ifdef DEBUG_TIME_ALIGNMENT
-            util::log_debug("New Inference: oldest frame is not old enough! We will store " + std::to_string(this->n_timestamped_frames * 2) + " frames now.");
+            util::log_debug("Time aligned buffer is over budget. Dropping frame from " + util::timestamp_to_string(this->timestamped_frames.front().timestamp));
         #endif
+        this->n_bytes -= frame_bytes(this->timestamped_frames.front().data);
+        this->timestamped_frames.pop_front();
+    }
 
-        // If oldest frame occurs after this
-        // frame's timestamp, we are overwriting our buffer frames before the network can inference even a single time.
-        // Therefore the buffer is not large enough and needs to be resized.
-        this->n_timestamped_frames *= 2;
+    // Frames almost always arrive in order, in which case this is the end of the buffer.
+    auto position = std::upper_bound(this->timestamped_frames.begin(), this->timestamped_frames.end(), stored.timestamp,
+                                     [](int64_t ts, const StoredFrame &f){ return ts < f.timestamp; });
+    this->timestamped_frames.insert(position, std::move(stored));
+    this->n_bytes += new_bytes;
+}
 
-        // Use this frame as the best one, but don't remove it, since it doesn't really match.
-        assert(best_match_ts == oldest_ts);
-        return std::vector<cv::Mat>{oldest_frame};
-    }
-    else
+cv::Mat TimeAlignedBuffer::decode(const StoredFrame &stored)
+{
+    if (stored.storage == Storage::JPEG)
     {
-        // If the oldest frame occurs before this inference, then the frame we are inferencing on
-        // is somewhere in our buffer. Search through to find it and all older frames.
-        std::vector<cv::Mat> best_and_older;
-        std::vector<size_t> indices_to_erase;
-        for (size_t i = 0; i < this->timestamped_frames.size(); i++)
-        {
-            const auto &tup = this->timestamped_frames.at(i);
-            if (std::get<1>(tup) <= best_match_ts)
-            {
-                indices_to_erase.push_back(i);
-                best_and_older.push_back(std::get<0>(tup));
-            }
-        }
+        return cv::imdecode(stored.data, cv::IMREAD_COLOR);
+    }
 
-        // Update the default value
-        this->default_value = best_and_older.back();
+    return stored.data;
+}
 
-        // Remove all the old frames.
-        assert(best_and_older.size() > 0);
-        assert(indices_to_erase.size() > 0);
-        auto start = indices_to_erase.at(0);
-        auto end = indices_to_erase.back() + 1;
-        this->timestamped_frames.erase(this->timestamped_frames.begin() + start, this->timestamped_frames.begin() + end);
+size_t TimeAlignedBuffer::size() const
+{
+    return this->timestamped_frames.size();
+}
 
-        // We need to decrement index by an amount equal
-        // to the number of indices we removed that are less than it.
-        size_t amount = 0;
-        for (auto i : indices_to_erase)
-        {
-            if (i < this->index)
-            {
-                amount++;
-            }
-        }
-        assert(amount <= this->index);
-        this->index -= amount;
+size_t TimeAlignedBuffer::bytes() const
+{
+    return this->n_bytes;
+}
 
+std::vector<sized_frame_t> TimeAlignedBuffer::get_best_match_and_older(int64_t timestamp)
+{
+    // If there is nothing in the buffer yet, let's return a default value.
+    if (this->timestamped_frames.empty())
+    {
         #ifdef DEBUG_TIME_ALIGNMENT
-            util::log_debug("New Inference: Found " + std::to_string(best_and_older.size()) + " frames. Now have " + std::to_string(this->size()) + " frames left.");
+            util::log_debug("New Inference: No frames in buffer. Sending cached frame.");
+        #endif
+        // The default value is the last frame we released, which has already gone out on the stream, and the caller
+        // will draw on what we return. So hand out a copy, rather than drawing over a frame the stream may be reading.
+        const cv::Mat &frame = std::get<0>(this->default_value);
+        return std::vector<sized_frame_t>{sized_frame_t(frame.clone(), std::get<1>(this->default_value))};
+    }
+
+    const auto &oldest = this->timestamped_frames.front();
+    if (oldest.timestamp > timestamp)
+    {
+        #ifdef DEBUG_TIME_ALIGNMENT
+            util::log_debug("New Inference: oldest frame is not old enough! The network is further behind than our memory budget allows.");
         #endif
 
-        return best_and_older;
+        // If oldest frame occurs after this frame's timestamp, we have dropped the frame the network
+        // inferenced on before it could finish. Use the oldest frame as the best one, but don't remove it,
+        // since it doesn't really match. Hand out a copy, since the caller will draw on it.
+        cv::Mat copy = (oldest.storage == Storage::JPEG) ? decode(oldest) : oldest.data.clone();
+        return std::vector<sized_frame_t>{sized_frame_t(copy, oldest.size)};
+    }
+
+    // The best match is either the first frame at or after the timestamp, or the one just before it (if there is one).
+    // If everything is older than the timestamp, the newest frame is the best match. Since the oldest frame is no newer
+    // than the timestamp, the buffer isn't empty and begin() is never end() here.
+    auto best = std::lower_bound(this->timestamped_frames.begin(), this->timestamped_frames.end(), timestamp,
+                                 [](const StoredFrame &f, int64_t ts){ return f.timestamp < ts; });
+    if ((best == this->timestamped_frames.end()) ||
+        ((best != this->timestamped_frames.begin()) && (timestamp - std::prev(best)->timestamp <= best->timestamp - timestamp)))
+    {
+        best = std::prev(best);
+    }
+
+    #ifdef DEBUG_TIME_ALIGNMENT
+        util::log_debug("New Inference: Matched " + util::timestamp_to_string(timestamp) + " with " + util::timestamp_to_string(best->timestamp));
+    #endif
+
+    // The best match and everything older than it are the front of the buffer, so take them all in one go.
+    // Compact frames stay compact: the caller scales what it draws on them instead.
+    auto end = std::next(best);
+    std::vector<sized_frame_t> best_and_older;
+    best_and_older.reserve(std::distance(this->timestamped_frames.begin(), end));
+    for (auto it = this->timestamped_frames.begin(); it != end; ++it)
+    {
+        this->n_bytes -= frame_bytes(it->data);
+        best_and_older.emplace_back((it->storage == Storage::JPEG) ? decode(*it) : std::move(it->data), it->size);
     }
+    this->timestamped_frames.erase(this->timestamped_frames.begin(), end);
+
+    // Update the default value
+    this->default_value = best_and_older.back();
+
+    #ifdef DEBUG_TIME_ALIGNMENT
+        util::log_debug("New Inference: Found " + std::to_string(best_and_older.size()) + " frames. Now have " + std::to_string(this->size()) + " frames left.");
+    #endif
+
+    return best_and_older;
 }
 
-} // namespace timebuf
\ No newline at end of file
+} // namespace timebuf
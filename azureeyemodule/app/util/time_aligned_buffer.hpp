@@ -8,6 +8,8 @@
 #pragma once
 
 // Standard library includes
+#include <atomic>
+#include <deque>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -23,33 +25,101 @@ namespace timebuf {
 /** A tuple of cv::Mat and timestamp for that frame. */
 using timestamped_frame_t = std::tuple<cv::Mat, int64_t>;
 
+/** A tuple of cv::Mat (possibly smaller than it was when it went into the buffer) and the size it was when it went in. */
+using sized_frame_t = std::tuple<cv::Mat, cv::Size>;
+
+/** The ways we can hold on to frames while they wait for their inference. */
+enum class Storage {
+    RAW,        // A full copy of the frame
+    RESIZED,    // A copy of the frame at the resolution of the stream it is going out on (if that is smaller)
+    JPEG,       // The frame, JPEG encoded (after shrinking it like RESIZED does)
+};
+
+/** Returns true if the given string is one of "raw", "resized", or "jpeg". */
+bool is_valid_storage(const std::string &storage);
+
+/** Returns the Storage enum variant from the given string. Throws an invalid_argument exception if the string is not valid. */
+Storage storage_string_to_enum(const std::string &storage);
+
+/** Returns a string representation of the Storage enum variant. */
+std::string storage_to_string(const Storage &storage);
+
+/** Sets how all time aligned buffers store the frames that are put into them from now on. Frames that are already in a buffer are unaffected. */
+void set_storage(const Storage &storage);
+
+/** Returns how time aligned buffers are currently storing their frames. */
+Storage get_storage();
+
+/**
+ * A buffer of timestamped frames, kept in timestamp order, from which we take out the frame that best matches
+ * a neural network inference (along with all the frames older than it).
+ *
+ * The buffer holds as many frames as fit in a fixed memory budget. If the network falls so far behind that
+ * the frames outgrow the budget, we drop the oldest ones rather than growing without bound. Storing the frames
+ * in a compact form (see `set_storage()`) lets far more of them fit.
+ */
 class TimeAlignedBuffer
 {
 public:
-    /** Constructor. Takes a default value to return until we get frames in the buffer. */
-    TimeAlignedBuffer(const cv::Mat &default_item);
+    /** By default, we hold on to up to this many bytes of frames (about 40 frames at 1080p). */
+    static const size_t DEFAULT_MAX_BYTES = 256 * 1024 * 1024;
+
+    /** Constructor. Takes a default value to return until we get frames in the buffer, and the memory budget for the frames. */
+    TimeAlignedBuffer(const cv::Mat &default_item, size_t max_bytes=DEFAULT_MAX_BYTES);
 
-    /** Copies the given frame and timestamp into the buffer, overwriting an old one if the we end up wrapping. */
-    void put(const timestamped_frame_t &frame_and_ts);
+    /**
+     * Copies the given frame and timestamp into the buffer (in whatever form `get_storage()` says), dropping
+     * the oldest frames if we would otherwise go over our memory budget.
+     *
+     * @param frame_and_ts: The frame and its timestamp.
+     * @param stream_size: The size of the stream the frame will go out on, which we shrink it to for RESIZED and JPEG storage.
+     */
+    void put(const timestamped_frame_t &frame_and_ts, const cv::Size &stream_size);
 
-    /** Removes the best matching frame and all older ones and returns them as a vector. If no frames in buffer, we return the default one or the last one we returned. */
-    std::vector<cv::Mat> get_best_match_and_older(int64_t timestamp);
+    /**
+     * Removes the best matching frame and all older ones and returns them as a vector. If no frames in buffer, we return the default one or the last one we returned.
+     * Frames come back at the size they were stored at, which may be smaller than the size they were put in at (and the inference results
+     * are in). So each one comes with its original size, for the caller to scale whatever it draws on it by.
+     */
+    std::vector<sized_frame_t> get_best_match_and_older(int64_t timestamp);
 
     /** Returns the current number of items in the buffer. */
     size_t size() const;
 
+    /** Returns the number of bytes of frame data currently in the buffer. */
+    size_t bytes() const;
+
 private:
-    /** The index to write something to. */
-    size_t index = 0;
+    /** The most bytes of frame data we are allowed to hold. */
+    size_t max_bytes;
 
-    /** Number of timestamped frames that we can currently have in the buffer. Increases if we need more capacity. */
-    size_t n_timestamped_frames;
+    /** The number of bytes of frame data we currently hold. */
+    size_t n_bytes = 0;
 
     /** The frame we return if there are no frames to return. */
-    cv::Mat default_value;
+    sized_frame_t default_value;
+
+    /** A frame as we hold on to it. */
+    struct StoredFrame
+    {
+        /** The frame's pixels, or its JPEG encoding. */
+        cv::Mat data;
+
+        /** The frame's timestamp. */
+        int64_t timestamp;
+
+        /** The frame's size when it was put into the buffer. */
+        cv::Size size;
+
+        /** How `data` is stored. */
+        Storage storage;
+    };
+
+    /** Frames with their timestamps, oldest first. */
+    std::deque<StoredFrame> timestamped_frames;
 
-    /** Circular buffer of frames with their timestamps. */
-    std::vector<timestamped_frame_t> timestamped_frames;
+    /** Turns a frame that we stored back into pixels (at the size we stored it at). */
+    static cv::Mat decode(const StoredFrame &stored);
 };
 
 } // namespace timebuf
\ No newline at end of file
@@ -10,6 +10,9 @@
 #include <opencv2/gapi.hpp>
 #include <opencv2/gapi/cpu/gcpukernel.hpp>
 
+// Local includes
+#include "ssd_parser.hpp"
+
 
 namespace cv {
 namespace gapi {
@@ -42,50 +45,10 @@ GAPI_OCV_KERNEL(GOCVParseSSDWithConf, GParseSSDWithConf)
 
         const int MAX_PROPOSALS = in_ssd_dims[2];
         const int OBJECT_SIZE = in_ssd_dims[3];
-        GAPI_Assert(OBJECT_SIZE == 7); // fixed SSD object size
-
-        out_boxes.clear();
-        out_labels.clear();
-        out_confidences.clear();
-
-        const auto items = in_ssd_result.ptr<float>();
-        for (int i = 0; i < MAX_PROPOSALS; i++)
-        {
-            const auto it = items + i * OBJECT_SIZE;
-            float image_id = it[0];
-            float label = it[1];
-            float confidence = it[2];
-            float rc_left = it[3];
-            float rc_top = it[4];
-            float rc_right = it[5];
-            float rc_bottom = it[6];
-
-            if (image_id < 0.f)
-            {
-                break;    // marks end-of-detections
-            }
-
-            if (confidence < confidence_threshold)
-            {
-                continue; // skip objects with low confidence
-            }
-
-            if (filter_label != -1 && static_cast<int>(label) != filter_label)
-            {
-                continue; // filter out object classes if filter is specified
-            }
-
-            const Rect surface({ 0,0 }, in_size);
+        GAPI_Assert(OBJECT_SIZE == ssd::OBJECT_SIZE); // fixed SSD object size
 
-            Rect rc;  // map relative coordinates to the original image scale
-            rc.x = static_cast<int>(rc_left * in_size.width);
-            rc.y = static_cast<int>(rc_top * in_size.height);
-            rc.width = static_cast<int>(rc_right * in_size.width) - rc.x;
-            rc.height = static_cast<int>(rc_bottom * in_size.height) - rc.y;
-            out_boxes.emplace_back(rc & surface);
-            out_labels.emplace_back(label);
-            out_confidences.emplace_back(confidence);
-        }
+        ssd::DetectionBuffer out(out_boxes, out_labels, out_confidences);
+        ssd::parse_ssd(in_ssd_result.ptr<float>(), MAX_PROPOSALS, in_size, confidence_threshold, filter_label, out);
     }
 };
 
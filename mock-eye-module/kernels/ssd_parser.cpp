@@ -0,0 +1,143 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// Standard libary includes
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+// Local includes
+#include "ssd_parser.hpp"
+
+namespace ssd {
+
+DetectionBuffer::DetectionBuffer(std::vector<cv::Rect> &boxes, std::vector<int> &labels, std::vector<float> &confidences)
+    : boxes(boxes), labels(labels), confidences(confidences)
+{
+}
+
+void DetectionBuffer::reset(size_t capacity)
+{
+    this->boxes.clear();
+    this->labels.clear();
+    this->confidences.clear();
+
+    this->boxes.reserve(capacity);
+    this->labels.reserve(capacity);
+    this->confidences.reserve(capacity);
+}
+
+void DetectionBuffer::push(const cv::Rect &box, int label, float confidence)
+{
+    this->boxes.push_back(box);
+    this->labels.push_back(label);
+    this->confidences.push_back(confidence);
+}
+
+size_t DetectionBuffer::size() const
+{
+    return this->boxes.size();
+}
+
+/** Maps the relative coordinates of the given proposal to the image and appends it to the buffer. */
+static inline void emit(const float *it, const cv::Size &in_size, const cv::Rect &surface, DetectionBuffer &out)
+{
+    cv::Rect rc;
+    rc.x = static_cast<int>(it[3] * in_size.width);
+    rc.y = static_cast<int>(it[4] * in_size.height);
+    rc.width = static_cast<int>(it[5] * in_size.width) - rc.x;
+    rc.height = static_cast<int>(it[6] * in_size.height) - rc.y;
+    out.push(rc & surface, static_cast<int>(it[1]), it[2]);
+}
+
+void parse_ssd(const float *items, int n_proposals, const cv::Size &in_size, float confidence_threshold, int filter_label, DetectionBuffer &out)
+{
+    out.reset(static_cast<size_t>(n_proposals));
+
+    const cv::Rect surface({ 0, 0 }, in_size);
+    int i = 0;
+
+#if CV_SIMD
+    // The proposals are rows of 7 floats, so we gather the image ID, label, and confidence columns
+    // of one batch of rows into lane-sized scratch arrays and do all the comparisons at once.
+    constexpr int lanes = cv::v_float32::nlanes;
+    float ids[lanes];
+    float labels[lanes];
+    float confidences[lanes];
+
+    const cv::v_float32 v_zero = cv::vx_setzero_f32();
+    const cv::v_float32 v_threshold = cv::vx_setall_f32(confidence_threshold);
+    const cv::v_int32 v_filter = cv::vx_setall_s32(filter_label);
+
+    for (; i <= n_proposals - lanes; i += lanes)
+    {
+        const float *batch = items + i * OBJECT_SIZE;
+        for (int k = 0; k < lanes; k++)
+        {
+            ids[k] = batch[k * OBJECT_SIZE];
+            labels[k] = batch[k * OBJECT_SIZE + 1];
+            confidences[k] = batch[k * OBJECT_SIZE + 2];
+        }
+
+        const cv::v_float32 v_ids = cv::vx_load(ids);
+        const cv::v_float32 v_confidences = cv::vx_load(confidences);
+
+        int keep = cv::v_signmask((v_confidences >= v_threshold) & (v_ids >= v_zero));
+        if (filter_label != -1)
+        {
+            keep &= cv::v_signmask(cv::v_trunc(cv::vx_load(labels)) == v_filter);
+        }
+
+        // A negative image ID marks the end of the detections. Keep only what comes before it and stop.
+        const int end = cv::v_signmask(v_ids < v_zero);
+        int n_valid = lanes;
+        if (end != 0)
+        {
+            n_valid = 0;
+            while (((end >> n_valid) & 1) == 0)
+            {
+                n_valid++;
+            }
+        }
+
+        for (int k = 0; keep != 0 && k < n_valid; k++)
+        {
+            if (keep & (1 << k))
+            {
+                emit(batch + k * OBJECT_SIZE, in_size, surface, out);
+            }
+        }
+
+        if (end != 0)
+        {
+            return;
+        }
+    }
+#endif
+
+    for (; i < n_proposals; i++)
+    {
+        const float *it = items + i * OBJECT_SIZE;
+
+        if (it[0] < 0.f)
+        {
+            break;    // marks end-of-detections
+        }
+
+        if (it[2] < confidence_threshold)
+        {
+            continue; // skip objects with low confidence
+        }
+
+        if (filter_label != -1 && static_cast<int>(it[1]) != filter_label)
+        {
+            continue; // filter out object classes if filter is specified
+        }
+
+        emit(it, in_size, surface, out);
+    }
+}
+
+} // namespace ssd
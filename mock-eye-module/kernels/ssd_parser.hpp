@@ -0,0 +1,63 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+
+// Standard libary includes
+#include <vector>
+
+// Third party includes
+#include <opencv2/core.hpp>
+
+namespace ssd {
+
+/** Number of floats in one SSD proposal: [image_id, label, confidence, left, top, right, bottom]. */
+constexpr int OBJECT_SIZE = 7;
+
+/**
+ * A structure-of-arrays view over the three outputs (boxes, labels, confidences) of a detection parser.
+ *
+ * Parsers write into this rather than into the three vectors independently, so that capacity
+ * is reserved once up front and the three columns always stay the same length.
+ */
+class DetectionBuffer
+{
+public:
+    /** Wraps the given output vectors. The vectors must outlive this object. */
+    DetectionBuffer(std::vector<cv::Rect> &boxes, std::vector<int> &labels, std::vector<float> &confidences);
+
+    /** Empties all three columns and makes sure they can each hold `capacity` detections without reallocating. */
+    void reset(size_t capacity);
+
+    /** Appends a single detection. */
+    void push(const cv::Rect &box, int label, float confidence);
+
+    /** Returns the number of detections in the buffer. */
+    size_t size() const;
+
+private:
+    /** Bounding boxes in image coordinates. */
+    std::vector<cv::Rect> &boxes;
+
+    /** Class indexes, one per box. */
+    std::vector<int> &labels;
+
+    /** Confidences, one per box. */
+    std::vector<float> &confidences;
+};
+
+/**
+ * Parses a raw SSD detection output into `out`.
+ *
+ * The confidence and label checks are done in SIMD batches over the proposals, and parsing
+ * stops at the first proposal whose image ID is negative (which is how SSD marks the end of its detections).
+ *
+ * @param items: Pointer to the first proposal of a {1, 1, N, 7} float tensor.
+ * @param n_proposals: N, the number of proposals in the tensor.
+ * @param in_size: The size of the image that the network ran on. Boxes are scaled to this and clipped to it.
+ * @param confidence_threshold: Proposals with a confidence below this are dropped.
+ * @param filter_label: If not -1, proposals with any other label are dropped.
+ * @param out: The buffer to write the detections into. It is reset first.
+ */
+void parse_ssd(const float *items, int n_proposals, const cv::Size &in_size, float confidence_threshold, int filter_label, DetectionBuffer &out);
+
+} // namespace ssd